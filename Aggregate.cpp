@@ -0,0 +1,236 @@
+#include "Aggregate.h"
+
+#include <algorithm>
+#include <chrono>
+#include "BackgroundLoad.h"
+#include "BTree.h"
+#include "CasesFile.h"
+#include "Map.h"
+#include "MemoryStats.h"
+#include "ParallelIngest.h"
+#include "Snapshot.h"
+#include "Stack.h"
+#include "StateIndex.h"
+#include "StringInterner.h"
+#include "Trace.h"
+
+using namespace std;
+
+int backendFromName(string_view name) {
+    for(int i = 0; i < BACKENDS; i++) {
+        if(name == BACKEND_NAMES[i])
+            return i;
+    }
+    return -1;
+}
+
+vector<int> hotspotsOf(const vector<long long>& stateCases) {
+    vector<int> order(stateCases.size());
+    for(size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<int>(i);
+    size_t count = min<size_t>(HOTSPOT_COUNT, order.size());
+    partial_sort(order.begin(), order.begin() + count, order.end(), [&](int a, int b) { return stateCases[a] > stateCases[b]; });
+    order.resize(count);
+    while(!order.empty() && stateCases[order.back()] <= 0)//states without cases are not hotspots
+        order.pop_back();
+    return order;
+}
+
+vector<int> hotspotsOf(const Map& map, const vector<string>& stateStrings) {
+    auto indexOf = [&](string_view key) {
+        return static_cast<int>(find(stateStrings.begin(), stateStrings.end(), key) - stateStrings.begin());
+    };
+    vector<int> hotspots;
+    //territories are in the map but not drawn, so they are skipped rather than counted toward the top keys
+    for(const auto& entry : map.topCases(HOTSPOT_COUNT, [&](string_view key) { return indexOf(key) < static_cast<int>(stateStrings.size()); })) {
+        if(entry.second > 0)
+            hotspots.push_back(indexOf(entry.first));
+    }
+    return hotspots;
+}
+
+AggregateResult aggregate(Backend backend, const string& path, const vector<string>& stateStrings, bool useSnapshot,
+                          LoadProgress* progress) {
+    AggregateResult result;
+    result.stateCases.assign(stateStrings.size(), 0);
+    TRACE_SCOPE(BACKEND_NAMES[backend]);//the whole run, with its stages nested under it in a trace
+    size_t allocationsBefore = allocationCount();
+    auto loadStart = chrono::high_resolution_clock::now();//start load timer
+    TraceScope open("open", &result.stages);
+    Snapshot snapshot;//binary copy of the file, used instead of parsing the csv while it is up to date
+    CasesFile casesFile;//map the data file into memory so rows can be read in place
+    SnapshotStamp stamp;//size and time of the csv as mapped, a snapshot written from it records these
+    result.fromSnapshot = useSnapshot && snapshot.open(snapshotPath(path), path);
+    if(!result.fromSnapshot && !casesFile.open(path))
+        return result;
+    bool stamped = !result.fromSnapshot && useSnapshot && snapshotStamp(path, stamp);
+    result.ok = true;
+    open.stop();
+    TraceScope build(result.fromSnapshot ? "decode+build" : "parse+build", &result.stages);
+    if(progress != nullptr && !result.fromSnapshot)
+        progress->bytesTotal = static_cast<size_t>(casesFile.end() - casesFile.begin());
+    auto forEachRow = [&](auto&& onRow) {//rows from whichever source is open
+        return result.fromSnapshot ? snapshot.forEachRow(onRow) : forEachRowReporting(casesFile.begin(), casesFile.end(), progress, onRow);
+    };
+    chrono::high_resolution_clock::time_point loadStop, start, stop;
+
+    if(backend == STACK) {
+        StringInterner stateIds;//each state name is stored once, the stack holds its ID
+        Stack s(result.fromSnapshot ? snapshot.rows() : casesFile.estimateRows());//create stack to store data in, sized from the file
+        forEachRow([&](const CaseRow& row) {
+            s.emplace(stateIds.intern(row.state), row.cases);//add current row to the stack
+        });
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();//end load timer
+        result.totalCases = s.totalCases;//get total cases for usage later
+        result.rows = s.size();
+        start = chrono::high_resolution_clock::now();//start microsecond timer
+        TraceScope retrieve("aggregate", &result.stages);
+        vector<int> stateOfId(stateIds.size(), -1);//index in stateStrings of each interned ID, -1 for non-states
+        for(uint32_t id = 0; id < stateIds.size(); id++) {
+            for(size_t j = 0; j < stateStrings.size(); j++){
+                if(stateStrings[j] == stateIds.name(id)) {
+                    stateOfId[id] = j;
+                    break;
+                }
+            }
+        }
+        /* Find the total number of cases in each state by popping off each data entry and adding it
+         * to the correct state total.
+         */
+        while(!s.isEmpty()) {
+            int j = stateOfId[s.top()->state];
+            if(j >= 0)
+                result.stateCases[j] += s.top()->cases;
+            s.pop();
+        }
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();//end microsecond timer
+        double loadSeconds = chrono::duration<double>(loadStop - loadStart).count();
+        double popSeconds = chrono::duration<double>(stop - start).count();
+        result.stats = "Push: " + to_string((long long) (result.rows / loadSeconds)) + " rows/s  Pop: "
+                + to_string((long long) (result.rows / popSeconds)) + " rows/s  Peak RSS: "
+                + to_string(peakResidentBytes() / (1024 * 1024)) + " MB";//push rate includes parsing the file
+    }
+    else if(backend == MAP) {
+        Map m;//create map object
+        result.rows = forEachRow([&](const CaseRow& row) {
+            m.insert(row.state, row.cases);
+        });
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();
+        result.totalCases = m.totalCases;
+        start = chrono::high_resolution_clock::now();
+        TraceScope retrieve("aggregate", &result.stages);
+        /* Get number of cases in each state by using the map's getCases function
+         * since the map uses a balanced tree data can efficiently be grabbed
+         */
+        for(size_t i = 0; i < stateStrings.size(); i++){
+            long long cases = m.getCases(stateStrings[i]);
+            result.stateCases[i] = cases < 0 ? 0 : cases;//states missing from the file have no cases
+        }
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();
+        result.hotspots = hotspotsOf(m, stateStrings);//found from the tree's subtree maxima instead of the state totals
+    }
+    else if(backend == PARALLEL && result.fromSnapshot) {//the snapshot's runs are decoded on every core
+        vector<long long> snapshotCases = snapshot.sumStates(0);
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();
+        result.totalCases = snapshot.totalCases();
+        result.rows = snapshot.rows();
+        start = chrono::high_resolution_clock::now();
+        TraceScope retrieve("aggregate", &result.stages);
+        for(uint32_t id = 0; id < snapshot.stateCount(); id++) {
+            for(size_t j = 0; j < stateStrings.size(); j++) {
+                if(stateStrings[j] == snapshot.stateName(id)) {
+                    result.stateCases[j] += snapshotCases[id];
+                    break;
+                }
+            }
+        }
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();
+    }
+    else if(backend == PARALLEL) {
+        ParallelAggregator p;//parse and count each chunk of the file on its own thread
+        p.ingest(casesFile, 0, progress);
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();
+        result.totalCases = p.totalCases;
+        result.rows = p.rows;
+        start = chrono::high_resolution_clock::now();
+        TraceScope retrieve("aggregate", &result.stages);
+        result.stateCases = p.merge(stateStrings);//combine the per thread counts into the state totals
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();
+        result.stats = to_string(p.threadCount()) + " threads";
+    }
+    else if(backend == HASH) {
+        StateCounter c;//perfect hash from state name to array index, one add per row
+        if(result.fromSnapshot) {//rows are already grouped by state, so each dictionary entry is hashed once
+            vector<long long> snapshotCases = snapshot.sumStates(1);
+            for(uint32_t id = 0; id < snapshot.stateCount(); id++)
+                c.add(snapshot.stateName(id), snapshotCases[id]);
+            result.rows = snapshot.rows();
+        }
+        else {
+            result.rows = forEachRow([&](const CaseRow& row) {
+                c.add(row.state, row.cases);
+            });
+        }
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();
+        result.totalCases = c.totalCases;
+        start = chrono::high_resolution_clock::now();
+        TraceScope retrieve("aggregate", &result.stages);
+        for(size_t i = 0; i < stateStrings.size(); i++) {
+            int index = stateIndex(stateStrings[i]);
+            result.stateCases[i] = index >= 0 ? c.getCases(index) : 0;
+        }
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();
+    }
+    else if(backend == BTREE) {
+        BTree t(stateStrings.size() * 2);//wide nodes with inline key prefixes, one descent per row
+        if(result.fromSnapshot) {//the snapshot's dictionary gives every key up front, so the tree is bulk loaded
+            vector<long long> snapshotCases = snapshot.sumStates(1);
+            vector<pair<string_view, long long>> sorted;
+            for(uint32_t id = 0; id < snapshot.stateCount(); id++)
+                sorted.emplace_back(snapshot.stateName(id), snapshotCases[id]);
+            sort(sorted.begin(), sorted.end());
+            t.bulkLoad(sorted);
+            result.rows = snapshot.rows();
+        }
+        else {
+            result.rows = forEachRow([&](const CaseRow& row) {
+                t.insert(row.state, row.cases);
+            });
+        }
+        build.stop();
+        loadStop = chrono::high_resolution_clock::now();
+        result.totalCases = t.totalCases;
+        start = chrono::high_resolution_clock::now();
+        TraceScope retrieve("aggregate", &result.stages);
+        for(size_t i = 0; i < stateStrings.size(); i++) {
+            long long cases = t.getCases(stateStrings[i]);
+            result.stateCases[i] = cases < 0 ? 0 : cases;
+        }
+        retrieve.stop();
+        stop = chrono::high_resolution_clock::now();
+    }
+
+    if(backend != MAP)
+        result.hotspots = hotspotsOf(result.stateCases);
+    result.loadMicros = chrono::duration_cast<chrono::microseconds>(loadStop - loadStart).count();
+    result.retrievalMicros = chrono::duration_cast<chrono::microseconds>(stop - start).count();
+    if(result.fromSnapshot)
+        result.stats += (result.stats.empty() ? "" : "  ") + string("Snapshot: ") + to_string(snapshot.size() / 1024) + " KB";
+    else if(useSnapshot && (progress == nullptr || !progress->cancelled)) {//not part of the load time, later runs read the snapshot
+        TraceScope write("snapshot write", &result.stages);
+        if(stamped && Snapshot::write(casesFile, stamp, snapshotPath(path)))
+            result.stats += (result.stats.empty() ? "" : "  ") + string("Snapshot written");
+    }
+    result.allocations = allocationCount() - allocationsBefore;
+    return result;
+}
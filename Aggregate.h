@@ -0,0 +1,47 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Trace.h"
+
+class Map;
+struct LoadProgress;
+
+// Data structures the per-state totals can be built with, selectable in the GUI and from the command line
+enum Backend { STACK, MAP, PARALLEL, HASH, BTREE, BACKENDS };
+
+const char* const BACKEND_NAMES[BACKENDS] = {"stack", "map", "parallel", "hash", "btree"}; // Command line names, indexed by Backend
+
+int backendFromName(std::string_view name); // Return the Backend called name, -1 if there is none
+
+const int HOTSPOT_COUNT = 10; // States labelled as hotspots on the map
+
+// Per-state totals built by one backend, along with how long each phase took
+struct AggregateResult {
+    bool ok = false; // Whether the data file could be opened
+    std::vector<long long> stateCases; // Total cases of each state, in stateStrings order
+    long long totalCases = 0; // Cases of every row, including rows for territories
+    size_t rows = 0; // Number of data rows read
+    long long loadMicros = 0; // Time to open, parse and build the backend's data structure
+    long long retrievalMicros = 0; // Time to get every state's total out of the data structure
+    std::string stats; // Extra measurements specific to the backend, empty if it has none
+    bool fromSnapshot = false; // Whether the rows were read from the binary snapshot instead of the csv
+    std::vector<int> hotspots; // Indices into stateCases of the states with the most cases, most first, at most HOTSPOT_COUNT
+    std::vector<StageTime> stages; // Time of each stage of the run in order, open, parse+build, aggregate and so on
+    size_t allocations = 0; // Calls to operator new during the run, from every thread
+};
+
+std::vector<int> hotspotsOf(const std::vector<long long>& stateCases); // The HOTSPOT_COUNT largest states with cases, by partial sort
+std::vector<int> hotspotsOf(const Map& map, const std::vector<std::string>& stateStrings); // As above, from the Map's top keys
+
+/* Read the file at path with the given backend and total the cases of each state in stateStrings. With useSnapshot
+ * the rows come from the binary snapshot next to the file when it is up to date, and a snapshot is written after
+ * parsing the csv when it is not. A progress, if given, is updated while the csv is parsed and can cancel the parse,
+ * the totals of a cancelled run are partial.
+ */
+AggregateResult aggregate(Backend backend, const std::string& path, const std::vector<std::string>& stateStrings,
+                          bool useSnapshot = false, LoadProgress* progress = nullptr);
+
+#endif
@@ -0,0 +1,267 @@
+#include "BTree.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+BTree::BTree() {
+    this->root = 0;
+    this->height = 0;
+    this->keyCount = 0;
+    this->totalCases = 0;
+}
+
+BTree::BTree(size_t expectedKeys, size_t expectedKeyBytes) : BTree() {
+    reserve(expectedKeys, expectedKeyBytes);
+}
+
+void BTree::reserve(size_t expectedKeys, size_t expectedKeyBytes) {
+    this->leaves.reserve(expectedKeys / (NODE_KEYS / 2) + 1); // Leaves are at least half full
+    this->inners.reserve(expectedKeys / (NODE_KEYS / 2 * (NODE_KEYS / 2 + 1)) + 1);
+    this->arena.reserve(expectedKeyBytes != 0 ? expectedKeyBytes : expectedKeys * 16); // Guess 16 bytes per key
+}
+
+void BTree::clear() {
+    this->leaves.clear();
+    this->inners.clear();
+    this->arena.clear();
+    this->root = 0;
+    this->height = 0;
+    this->keyCount = 0;
+    this->totalCases = 0;
+}
+
+int BTree::compare(string_view state, uint64_t prefix, uint64_t nodePrefix, const KeyRef& key) const {
+    if(prefix != nodePrefix)
+        return prefix < nodePrefix ? -1 : 1;
+    if(state.size() <= 8 && key.length <= 8) // Both keys fit in the prefix, only the lengths can differ
+        return state.size() == key.length ? 0 : (state.size() < key.length ? -1 : 1);
+    return state.compare(keyOf(key));
+}
+
+int BTree::childIndex(const Inner& node, string_view state, uint64_t prefix) const {
+    int low = 0;
+    int count = static_cast<int>(node.count);
+    while(low < count && node.prefixes[low] < prefix) // Separators below state on their prefix alone
+        low++;
+    int high = low;
+    while(high < count && node.prefixes[high] == prefix)
+        high++;
+    while(low < high) { // Separators sharing state's prefix are told apart by binary search on the full keys
+        int middle = (low + high) / 2;
+        if(compare(state, prefix, node.prefixes[middle], node.keys[middle]) >= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int BTree::leafIndex(const Leaf& leaf, string_view state, uint64_t prefix, bool& found) const {
+    int low = 0;
+    int count = static_cast<int>(leaf.count);
+    while(low < count && leaf.prefixes[low] < prefix)
+        low++;
+    int high = low;
+    while(high < count && leaf.prefixes[high] == prefix)
+        high++;
+    found = false;
+    while(low < high) {
+        int middle = (low + high) / 2;
+        int order = compare(state, prefix, leaf.prefixes[middle], leaf.keys[middle]);
+        if(order == 0) {
+            found = true;
+            return middle;
+        }
+        if(order > 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+BTree::KeyRef BTree::intern(string_view state) {
+    KeyRef key = {static_cast<uint32_t>(this->arena.size()), static_cast<uint32_t>(state.size())};
+    this->arena.insert(this->arena.end(), state.begin(), state.end());
+    return key;
+}
+
+void BTree::splitChild(uint32_t parent, int child, bool childIsLeaf) {
+    uint64_t separatorPrefix;
+    KeyRef separator;
+    uint32_t right;
+    if(childIsLeaf) { // The right half keeps its first key, a copy of it goes up as the separator
+        right = static_cast<uint32_t>(this->leaves.size());
+        this->leaves.emplace_back();
+        Leaf& l = this->leaves[this->inners[parent].children[child]];
+        Leaf& r = this->leaves[right];
+        uint32_t keep = (NODE_KEYS + 1) / 2;
+        r.count = NODE_KEYS - keep;
+        copy(l.prefixes + keep, l.prefixes + NODE_KEYS, r.prefixes);
+        copy(l.keys + keep, l.keys + NODE_KEYS, r.keys);
+        copy(l.cases + keep, l.cases + NODE_KEYS, r.cases);
+        l.count = keep;
+        r.next = l.next;
+        l.next = right;
+        separatorPrefix = r.prefixes[0];
+        separator = r.keys[0];
+    }
+    else { // The middle separator moves up, the halves on either side of it become two nodes
+        right = static_cast<uint32_t>(this->inners.size());
+        this->inners.emplace_back();
+        Inner& l = this->inners[this->inners[parent].children[child]];
+        Inner& r = this->inners[right];
+        uint32_t middle = NODE_KEYS / 2;
+        r.count = NODE_KEYS - middle - 1;
+        copy(l.prefixes + middle + 1, l.prefixes + NODE_KEYS, r.prefixes);
+        copy(l.keys + middle + 1, l.keys + NODE_KEYS, r.keys);
+        copy(l.children + middle + 1, l.children + NODE_KEYS + 1, r.children);
+        l.count = middle;
+        separatorPrefix = l.prefixes[middle];
+        separator = l.keys[middle];
+    }
+    Inner& p = this->inners[parent];
+    copy_backward(p.prefixes + child, p.prefixes + p.count, p.prefixes + p.count + 1);
+    copy_backward(p.keys + child, p.keys + p.count, p.keys + p.count + 1);
+    copy_backward(p.children + child + 1, p.children + p.count + 1, p.children + p.count + 2);
+    p.prefixes[child] = separatorPrefix;
+    p.keys[child] = separator;
+    p.children[child + 1] = right;
+    p.count++;
+}
+
+uint32_t BTree::splitRoot() {
+    uint32_t newRoot = static_cast<uint32_t>(this->inners.size());
+    this->inners.emplace_back();
+    this->inners[newRoot].count = 0;
+    this->inners[newRoot].children[0] = this->root;
+    splitChild(newRoot, 0, this->height == 0);
+    this->root = newRoot;
+    this->height++;
+    return newRoot;
+}
+
+void BTree::insert(string_view state, int cases) {
+    this->totalCases += cases;
+    uint64_t prefix = keyPrefix(state);
+    if(this->leaves.empty()) {
+        this->leaves.emplace_back();
+        this->leaves[0].count = 0;
+        this->leaves[0].next = NONE;
+        this->root = 0;
+    }
+    if((this->height == 0 ? this->leaves[this->root].count : this->inners[this->root].count) == NODE_KEYS)
+        splitRoot();
+
+    // Single descent, a full child is split before stepping into it so the leaf always has room for a new key
+    uint32_t node = this->root;
+    for(int level = this->height; level > 0; level--) {
+        int child = childIndex(this->inners[node], state, prefix);
+        uint32_t next = this->inners[node].children[child];
+        bool childIsLeaf = level == 1;
+        if((childIsLeaf ? this->leaves[next].count : this->inners[next].count) == NODE_KEYS) {
+            splitChild(node, child, childIsLeaf);
+            const Inner& parent = this->inners[node];
+            if(compare(state, prefix, parent.prefixes[child], parent.keys[child]) >= 0)
+                child++;
+            next = parent.children[child];
+        }
+        node = next;
+    }
+
+    Leaf& leaf = this->leaves[node];
+    bool found;
+    int i = leafIndex(leaf, state, prefix, found);
+    if(found) { // Will add cases to existing state
+        leaf.cases[i] += cases;
+        return;
+    }
+    copy_backward(leaf.prefixes + i, leaf.prefixes + leaf.count, leaf.prefixes + leaf.count + 1);
+    copy_backward(leaf.keys + i, leaf.keys + leaf.count, leaf.keys + leaf.count + 1);
+    copy_backward(leaf.cases + i, leaf.cases + leaf.count, leaf.cases + leaf.count + 1);
+    leaf.prefixes[i] = prefix;
+    leaf.keys[i] = intern(state); // Intern the key once
+    leaf.cases[i] = cases;
+    leaf.count++;
+    this->keyCount++;
+}
+
+long long BTree::getCases(string_view state) const {
+    if(this->keyCount == 0)
+        return -1;
+    uint64_t prefix = keyPrefix(state);
+    uint32_t node = this->root;
+    for(int level = this->height; level > 0; level--)
+        node = this->inners[node].children[childIndex(this->inners[node], state, prefix)];
+    bool found;
+    int i = leafIndex(this->leaves[node], state, prefix, found);
+    return found ? this->leaves[node].cases[i] : -1; // -1 for an invalid state
+}
+
+void BTree::bulkLoad(const vector<pair<string_view, long long>>& sorted) {
+    clear();
+    // Sum equal neighbours into one key each
+    vector<pair<KeyRef, long long>> keys;
+    keys.reserve(sorted.size());
+    for(const auto& entry : sorted) {
+        this->totalCases += entry.second;
+        if(!keys.empty() && keyOf(keys.back().first) == entry.first)
+            keys.back().second += entry.second;
+        else
+            keys.emplace_back(intern(entry.first), entry.second);
+    }
+    this->keyCount = keys.size();
+    if(keys.empty())
+        return;
+
+    // Size of each of groups groups when count items are spread over them, sizes differ by at most one
+    auto groupSize = [](size_t count, size_t groups, size_t group) {
+        return count / groups + (group < count % groups ? 1 : 0);
+    };
+    vector<uint32_t> level; // Nodes of the level being built, left to right
+    vector<pair<uint64_t, KeyRef>> smallest; // Smallest key under each node of the level
+    size_t leafCount = (keys.size() + NODE_KEYS - 1) / NODE_KEYS;
+    this->leaves.resize(leafCount);
+    size_t next = 0;
+    for(size_t g = 0; g < leafCount; g++) {
+        Leaf& leaf = this->leaves[g];
+        leaf.count = static_cast<uint32_t>(groupSize(keys.size(), leafCount, g));
+        for(uint32_t i = 0; i < leaf.count; i++, next++) {
+            leaf.keys[i] = keys[next].first;
+            leaf.prefixes[i] = keyPrefix(keyOf(keys[next].first));
+            leaf.cases[i] = keys[next].second;
+        }
+        leaf.next = g + 1 < leafCount ? static_cast<uint32_t>(g + 1) : NONE;
+        level.push_back(static_cast<uint32_t>(g));
+        smallest.emplace_back(leaf.prefixes[0], leaf.keys[0]);
+    }
+    this->height = 0;
+    while(level.size() > 1) {
+        size_t parents = (level.size() + NODE_KEYS) / (NODE_KEYS + 1);
+        vector<uint32_t> above;
+        vector<pair<uint64_t, KeyRef>> aboveSmallest;
+        size_t child = 0;
+        for(size_t g = 0; g < parents; g++) {
+            uint32_t index = static_cast<uint32_t>(this->inners.size());
+            this->inners.emplace_back();
+            Inner& inner = this->inners[index];
+            size_t children = groupSize(level.size(), parents, g);
+            inner.count = static_cast<uint32_t>(children - 1);
+            aboveSmallest.push_back(smallest[child]);
+            for(size_t c = 0; c < children; c++, child++) {
+                inner.children[c] = level[child];
+                if(c > 0) {
+                    inner.prefixes[c - 1] = smallest[child].first;
+                    inner.keys[c - 1] = smallest[child].second;
+                }
+            }
+            above.push_back(index);
+        }
+        level.swap(above);
+        smallest.swap(aboveSmallest);
+        this->height++;
+    }
+    this->root = level[0];
+}
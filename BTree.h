@@ -0,0 +1,85 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Map.h"
+
+/* Ordered map from state name to cases built as a B+-tree with wide nodes. Each node keeps the 8-byte prefixes of
+ * its keys in one array, so finding the next child is a scan over a few cache lines of integers instead of one miss
+ * and one string compare per level like the red/black Map. Full nodes are split on the way down, so an upsert is a
+ * single descent from the root. Keys are stored once in a char arena, leaves are linked in key order.
+ */
+class BTree {
+public:
+    static const int NODE_KEYS = 15; // Keys per node, an odd count so an inner node splits around a middle key
+    static const uint32_t NONE = 0xFFFFFFFF; // Index used for a missing leaf link
+private:
+    struct KeyRef {
+        uint32_t offset; // Offset of the key in the arena
+        uint32_t length; // Length of the key in bytes
+    };
+    struct Leaf {
+        uint64_t prefixes[NODE_KEYS]; // keyPrefix of each key, ascending
+        KeyRef keys[NODE_KEYS];
+        long long cases[NODE_KEYS]; // Total cases of each key
+        uint32_t count; // Keys in use
+        uint32_t next; // Leaf holding the following keys, NONE for the last leaf
+    };
+    struct Inner {
+        uint64_t prefixes[NODE_KEYS]; // keyPrefix of each separator, ascending
+        KeyRef keys[NODE_KEYS]; // Separator i is the smallest key under children[i + 1]
+        uint32_t children[NODE_KEYS + 1]; // Indices into inners one level down, or into leaves from the lowest level
+        uint32_t count; // Separators in use, there is one more child
+    };
+    std::vector<Leaf> leaves;
+    std::vector<Inner> inners;
+    std::vector<char> arena; // Bytes of every distinct key back to back
+    uint32_t root; // Index of the root, in leaves when height is 0 and in inners otherwise
+    int height; // Inner levels above the leaves
+    size_t keyCount; // Number of distinct keys
+
+    std::string_view keyOf(const KeyRef& key) const { return std::string_view(arena.data() + key.offset, key.length); }
+    int compare(std::string_view state, uint64_t prefix, uint64_t nodePrefix, const KeyRef& key) const; // Order state against a stored key
+    int childIndex(const Inner& node, std::string_view state, uint64_t prefix) const; // Child of node whose range holds state
+    int leafIndex(const Leaf& leaf, std::string_view state, uint64_t prefix, bool& found) const; // Position of state in leaf, or where it would go
+    KeyRef intern(std::string_view state); // Copy a new key into the arena
+    void splitChild(uint32_t parent, int child, bool childIsLeaf); // Split the full child of parent in two, parent must have room
+    uint32_t splitRoot(); // Grow the tree one level when the root is full, returns the new root
+public:
+    long long totalCases;
+
+    BTree(); // Constructor, creates an empty tree with total cases 0
+    explicit BTree(size_t expectedKeys, size_t expectedKeyBytes = 0); // Constructor, reserves room for expectedKeys keys
+
+    void insert(std::string_view state, int cases); // Add cases to the state's key, inserting the key if the state is new
+    long long getCases(std::string_view state) const; // Return the number of cases in a given state, -1 if it is not in the tree
+    size_t size() const { return keyCount; } // Number of distinct keys
+    void reserve(size_t expectedKeys, size_t expectedKeyBytes = 0); // Reserve node and key storage up front
+    void clear(); // Remove every key and reset total cases to 0
+    /* Replace the contents with keys sorted in ascending order, equal neighbours are summed. Leaves are filled
+     * left to right and each inner level is built from the one below, so nothing is split or searched.
+     */
+    void bulkLoad(const std::vector<std::pair<std::string_view, long long>>& sorted);
+    template <class F>
+    void forEach(F&& visit) const; // Call visit(key, cases) for every key in order
+};
+
+template <class F>
+void BTree::forEach(F&& visit) const {
+    if(keyCount == 0)
+        return;
+    uint32_t node = root;
+    for(int level = height; level > 0; level--) // Leftmost leaf
+        node = inners[node].children[0];
+    for(; node != NONE; node = leaves[node].next) {
+        const Leaf& leaf = leaves[node];
+        for(uint32_t i = 0; i < leaf.count; i++)
+            visit(keyOf(leaf.keys[i]), leaf.cases[i]);
+    }
+}
+
+#endif
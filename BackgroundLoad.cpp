@@ -0,0 +1,34 @@
+#include "BackgroundLoad.h"
+
+using namespace std;
+
+BackgroundLoad::~BackgroundLoad() {
+    if(this->worker.joinable()) {
+        cancel();
+        this->worker.join();
+    }
+}
+
+bool BackgroundLoad::start(function<void(LoadProgress&)> job) {
+    if(this->worker.joinable())
+        return false;
+    this->progress.reset();
+    this->finished = false;
+    this->started = chrono::steady_clock::now();
+    this->worker = thread([this, job = move(job)]() {
+        job(this->progress);
+        this->finished = true;
+    });
+    return true;
+}
+
+bool BackgroundLoad::poll() {
+    if(!this->worker.joinable() || !this->finished)
+        return false;
+    this->worker.join();//the job has returned, so this does not wait
+    return true;
+}
+
+double BackgroundLoad::elapsedSeconds() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - this->started).count();
+}
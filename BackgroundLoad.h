@@ -0,0 +1,67 @@
+#ifndef BACKGROUNDLOAD_H
+#define BACKGROUNDLOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "CasesFile.h"
+
+// Progress of a load running on another thread, written by the loader and read by the GUI without locking
+struct LoadProgress {
+    std::atomic<size_t> bytesTotal{0}; // Bytes of rows the load will parse, 0 until the file is opened
+    std::atomic<size_t> bytesDone{0}; // Bytes of rows parsed so far
+    std::atomic<size_t> rows{0}; // Rows parsed so far
+    std::atomic<bool> cancelled{false}; // Set to ask the loader to stop, checked between blocks
+
+    void reset() { bytesTotal = 0; bytesDone = 0; rows = 0; cancelled = false; }
+};
+
+const size_t PROGRESS_BLOCK = 4 << 20; // Bytes parsed between progress updates and cancel checks
+
+// Parse [begin, end) like forEachRow, in newline-aligned blocks that report to progress and stop once it is cancelled.
+// A null progress parses everything in one go
+template <class F>
+size_t forEachRowReporting(const char* begin, const char* end, LoadProgress* progress, F&& onRow) {
+    if(progress == nullptr)
+        return forEachRow(begin, end, onRow);
+    size_t rows = 0;
+    while(begin < end && !progress->cancelled) {
+        const char* stop = static_cast<size_t>(end - begin) > PROGRESS_BLOCK ? begin + PROGRESS_BLOCK : end;
+        if(stop < end) {
+            const char* newline = static_cast<const char*>(memchr(stop, '\n', end - stop));
+            stop = newline != nullptr ? newline + 1 : end;
+        }
+        size_t blockRows = forEachRow(begin, stop, onRow);
+        rows += blockRows;
+        progress->rows += blockRows;
+        progress->bytesDone += static_cast<size_t>(stop - begin);
+        begin = stop;
+    }
+    return rows;
+}
+
+// Runs one load at a time on a background thread, the render loop polls it instead of waiting
+class BackgroundLoad {
+    std::thread worker; // Thread running the current job
+    std::atomic<bool> finished; // Set by the worker when the job returns
+    LoadProgress progress; // Progress of the current job
+    std::chrono::steady_clock::time_point started; // When the current job started
+public:
+    BackgroundLoad() { finished = false; }
+    ~BackgroundLoad(); // Cancels a running job and waits for it
+    BackgroundLoad(const BackgroundLoad&) = delete;
+    BackgroundLoad& operator=(const BackgroundLoad&) = delete;
+
+    bool start(std::function<void(LoadProgress&)> job); // Run job on the worker, returns false if one is already running
+    bool isRunning() const { return worker.joinable(); } // Whether a job was started and not yet collected by poll()
+    bool poll(); // Returns true once, when the job has finished, its results can then be read on this thread
+    void cancel() { progress.cancelled = true; } // Ask the job to stop early, it still has to be collected with poll()
+    bool wasCancelled() const { return progress.cancelled; } // Whether the last job was asked to stop, its results are partial
+    const LoadProgress& getProgress() const { return progress; }
+    double elapsedSeconds() const; // Time since the current job started
+};
+
+#endif
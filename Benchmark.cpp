@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Aggregate.h"
+#include "BTree.h"
+#include "Map.h"
+#include "MemoryStats.h"
+#include "Snapshot.h"
+#include "StateIndex.h"
+#include "Trace.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Standalone benchmark of every aggregation backend, run end to end (map, parse, build, query) on synthetic files
+
+// Timings of one backend on one file, every time is in microseconds
+struct BenchResult {
+    string file;
+    size_t rows = 0;
+    size_t keys = 0;
+    Backend backend = STACK;
+    vector<long long> total; // End to end time of each measured run
+    vector<long long> load; // Load phase reported by aggregate() for each run
+    vector<long long> retrieval; // Retrieval phase reported by aggregate() for each run
+    size_t peakBytes = 0; // Peak resident size while this backend ran
+    bool peakIsolated = false; // Whether the peak was reset before the backend ran, otherwise it includes earlier backends
+    long long totalCases = 0; // Checksum, every backend must agree
+    size_t allocations = 0; // Calls to operator new during the last run
+};
+
+// Cost of one kind of ordered query on the Map against a sorted vector with prefix sums, in nanoseconds per query
+struct QueryResult {
+    size_t keys = 0;
+    string query;
+    long long mapNanos = 0; // Median over the measured runs
+    long long vectorNanos = 0;
+    long long checksum = 0; // Sum of every answer, both structures must agree
+};
+
+// Cost of building and reading the red/black Map against the B+-tree on the same keys, in nanoseconds per operation
+struct TreeResult {
+    size_t keys = 0;
+    bool spreadPrefix = false; // Keys start with a hashed prefix, otherwise they all share "Key " and the tree compares full keys
+    size_t upserts = 0; // Inserts timed per run, the first of each key adds it and the rest add to it
+    long long mapInsertNanos = 0; // Median over the measured runs
+    long long btreeInsertNanos = 0;
+    long long btreeBulkNanos = 0; // Bulk load from the sorted totals, per key
+    long long mapLookupNanos = 0;
+    long long btreeLookupNanos = 0;
+    long long checksum = 0; // Sum of every lookup, both trees must agree
+};
+
+const int QUERIES_PER_RUN = 20000; // Queries timed together, so each run is long enough to measure
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [--rows <n,...>] [--keys <n,...>] [--repeat <n>] [--warmup <n>]\n"
+         << "       [--backend <name>] [--dir <directory>] [--output <results.json>] [--keep] [--snapshot]\n"
+         << "       [--trace <trace.json>] [--tree-keys <n,...>]\n"
+         << "Generates a synthetic cases.csv for every rows x keys combination, then runs every backend on each.\n"
+         << "Defaults: --rows 1000000 --keys 55,3200 --repeat 7 --warmup 2, results are written to stdout.\n"
+         << "With --snapshot the backends read a binary snapshot of each file, written during the warmup runs.\n"
+         << "Keys beyond the 50 states get synthetic names, so they are stored by the backends but not queried.\n"
+         << "The Map's ordered queries are also timed against a sorted vector for every key count.\n"
+         << "The Map and the B+-tree are timed on their own for every --tree-keys count, default 50,3000,1000000,\n"
+         << "once with keys sharing their first bytes and once with a hashed prefix in front of them.\n"
+         << "With --trace every stage of every run is written as Chrome trace-event JSON." << endl;
+}
+
+// Parse a comma separated list of positive counts, returns false if any entry is not a number
+static bool parseCounts(const string& text, vector<size_t>& counts) {
+    counts.clear();
+    stringstream stream(text);
+    string item;
+    while(getline(stream, item, ',')) {
+        try {
+            size_t used;
+            unsigned long long value = stoull(item, &used);
+            if(used != item.size() || value == 0)
+                return false;
+            counts.push_back(static_cast<size_t>(value));
+        }
+        catch(const exception&) {
+            return false;
+        }
+    }
+    return !counts.empty();
+}
+
+// Write rows rows over keys distinct state names in the layout of cases.csv, one row per key per day
+static bool generateFile(const string& path, size_t rows, size_t keys) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if(out == nullptr)
+        return false;
+    vector<string> names(keys);
+    for(size_t k = 0; k < keys; k++)
+        names[k] = k < STATE_COUNT ? string(STATE_NAMES[k]) : "Territory " + to_string(k - STATE_COUNT);
+    string buffer = "date,county,state,fips,cases,deaths\n";
+    buffer.reserve(1 << 20);
+    char date[32];//room for any int year, so -Wformat-truncation stays quiet
+    for(size_t row = 0; row < rows; row++) {
+        size_t day = row / keys, key = row % keys;
+        if(key == 0)//a new day, 28 days a month keeps every date valid
+            snprintf(date, sizeof(date), "%04d-%02d-%02d", 2020 + static_cast<int>(day / 336), static_cast<int>(day / 28 % 12) + 1, static_cast<int>(day % 28) + 1);
+        buffer += date;
+        buffer += ",County ";
+        buffer += to_string(key);
+        buffer += ',';
+        buffer += names[key];
+        buffer += ',';
+        buffer += to_string(10000 + key);
+        buffer += ',';
+        buffer += to_string((day + 1) * (key % 97 + 1));//cumulative, grows every day
+        buffer += ",0\n";
+        if(buffer.size() > (1 << 20) - 256) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), out);
+    return fclose(out) == 0;
+}
+
+// Nearest-rank percentile of a list of times
+static long long percentile(vector<long long> times, double p) {
+    sort(times.begin(), times.end());
+    size_t rank = static_cast<size_t>(p * times.size() + 0.999999);
+    return times[min(times.size(), max<size_t>(rank, 1)) - 1];
+}
+
+/* Time prefix range sums, rank, select, top 10 and adding cases to a key on a Map of keys keys and on the sorted
+ * vector baseline. The vector answers the static queries with binary search over prefix sums but has to rebuild the
+ * sums after every update and scan every key for the top 10, which is where the tree's subtree fields pay off.
+ */
+static vector<QueryResult> benchQueries(size_t keys, int repeat, int warmup, bool& mismatch) {
+    mt19937 random(12345);
+    vector<pair<string, long long>> sorted(keys);
+    for(size_t k = 0; k < keys; k++)
+        sorted[k] = {"Key " + to_string(k * 7919 % 1000003) + (k >= 1000003 ? "-" + to_string(k) : ""), static_cast<long long>(random() % 1000000)};//the index suffix keeps names unique past 1000003 keys
+    sort(sorted.begin(), sorted.end());
+    Map map(keys);
+    for(const auto& entry : sorted)
+        map.insert(entry.first, static_cast<int>(entry.second));
+    vector<long long> prefix(keys + 1, 0);//prefix[i] is the total of the first i keys
+    auto rebuildPrefix = [&]() {
+        for(size_t k = 0; k < keys; k++)
+            prefix[k + 1] = prefix[k] + sorted[k].second;
+    };
+    rebuildPrefix();
+    auto lowerIndex = [&](const string& key) {
+        return static_cast<size_t>(lower_bound(sorted.begin(), sorted.end(), key, [](const pair<string, long long>& entry, const string& k) { return entry.first < k; }) - sorted.begin());
+    };
+    vector<size_t> picks(QUERIES_PER_RUN * 2);
+    for(size_t& pick : picks)
+        pick = random() % keys;
+
+    // Each query kind runs the same picks on both structures and returns the sum of its answers
+    struct Kind {
+        string name;
+        function<long long()> onMap, onVector;
+    };
+    vector<Kind> kinds = {
+        {"range", [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++) {
+                const string& a = sorted[picks[2 * q]].first;
+                const string& b = sorted[picks[2 * q + 1]].first;
+                sum += map.rangeCases(min(a, b), max(a, b));
+            }
+            return sum;
+        }, [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++) {
+                const string& a = sorted[picks[2 * q]].first;
+                const string& b = sorted[picks[2 * q + 1]].first;
+                sum += prefix[lowerIndex(max(a, b)) + 1] - prefix[lowerIndex(min(a, b))];
+            }
+            return sum;
+        }},
+        {"rank", [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++)
+                sum += map.rank(sorted[picks[q]].first);
+            return sum;
+        }, [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++)
+                sum += lowerIndex(sorted[picks[q]].first);
+            return sum;
+        }},
+        {"select", [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++)
+                sum += map.select(picks[q]).size();
+            return sum;
+        }, [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN; q++)
+                sum += sorted[picks[q]].first.size();
+            return sum;
+        }},
+        {"top10", [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN / 100; q++) {
+                for(const auto& entry : map.topCases(10))
+                    sum += entry.second;
+            }
+            return sum;
+        }, [&]() {
+            long long sum = 0;
+            vector<long long> cases(keys);
+            for(int q = 0; q < QUERIES_PER_RUN / 100; q++) {
+                for(size_t k = 0; k < keys; k++)
+                    cases[k] = sorted[k].second;
+                size_t count = min<size_t>(10, keys);
+                partial_sort(cases.begin(), cases.begin() + count, cases.end(), greater<long long>());
+                for(size_t k = 0; k < count; k++)
+                    sum += cases[k];
+            }
+            return sum;
+        }},
+        {"update", [&]() {//add one case to a key, then ask for the total of every key before it
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN / 100; q++) {
+                map.insert(sorted[picks[q]].first, 1);
+                sum += map.prefixCases(sorted[picks[q]].first);
+            }
+            return sum;
+        }, [&]() {
+            long long sum = 0;
+            for(int q = 0; q < QUERIES_PER_RUN / 100; q++) {
+                sorted[picks[q]].second++;
+                rebuildPrefix();
+                sum += prefix[picks[q]];
+            }
+            return sum;
+        }},
+    };
+    vector<QueryResult> results;
+    for(const Kind& kind : kinds) {
+        QueryResult result;
+        result.keys = keys;
+        result.query = kind.name;
+        int perRun = kind.name == "top10" || kind.name == "update" ? QUERIES_PER_RUN / 100 : QUERIES_PER_RUN;
+        vector<long long> mapTimes, vectorTimes;
+        long long mapSum = 0, vectorSum = 0;
+        for(int run = 0; run < warmup + repeat; run++) {
+            auto start = chrono::high_resolution_clock::now();
+            long long sum = kind.onMap();
+            auto middle = chrono::high_resolution_clock::now();
+            long long baseline = kind.onVector();
+            auto stop = chrono::high_resolution_clock::now();
+            if(run == 0) {//updates change the totals, so only the first run's answers are compared
+                mapSum = sum;
+                vectorSum = baseline;
+            }
+            if(run < warmup)
+                continue;
+            mapTimes.push_back(chrono::duration_cast<chrono::nanoseconds>(middle - start).count() / perRun);
+            vectorTimes.push_back(chrono::duration_cast<chrono::nanoseconds>(stop - middle).count() / perRun);
+        }
+        if(mapSum != vectorSum) {
+            cerr << kind.name << " queries on " << keys << " keys disagree: " << mapSum << " on the map, " << vectorSum << " on the sorted vector" << endl;
+            mismatch = true;
+        }
+        result.mapNanos = percentile(mapTimes, 0.5);
+        result.vectorNanos = percentile(vectorTimes, 0.5);
+        result.checksum = mapSum;
+        cerr << keys << " keys " << kind.name << ": map " << result.mapNanos << " ns, sorted vector " << result.vectorNanos << " ns" << endl;
+        results.push_back(result);
+    }
+    return results;
+}
+
+/* Time upserts, bulk loading and lookups on the Map and the BTree with keys distinct keys, outside of any file so
+ * the trees' own costs are all that is measured. Upserts visit the keys round robin like the days of cases.csv.
+ * "Key NNNNNN" names tie on the B+-tree's 8 byte prefixes, so with spreadPrefix each one starts with 8 hex digits
+ * of a hash of it instead, which shows the tree when its prefixes tell keys apart.
+ */
+static TreeResult benchTrees(size_t keys, bool spreadPrefix, int repeat, int warmup, bool& mismatch) {
+    mt19937 random(54321);
+    vector<string> names(keys);
+    for(size_t k = 0; k < keys; k++) {
+        names[k] = "Key " + to_string(k * 7919 % 1000003) + (k >= 1000003 ? "-" + to_string(k) : "");
+        if(spreadPrefix) {
+            char prefix[16];
+            snprintf(prefix, sizeof(prefix), "%08x ", static_cast<unsigned>(hash<string>()(names[k]) >> 7));
+            names[k] = prefix + names[k];//still unique, the name follows the prefix
+        }
+    }
+    TreeResult result;
+    result.keys = keys;
+    result.spreadPrefix = spreadPrefix;
+    result.upserts = max<size_t>(keys * 2, 1000000);
+    vector<int> cases(result.upserts);
+    for(int& c : cases)
+        c = static_cast<int>(random() % 1000);
+    vector<pair<string_view, long long>> sorted;
+    vector<long long> mapInsert, btreeInsert, btreeBulk, mapLookup, btreeLookup;
+    long long mapSum = 0, btreeSum = 0;
+    auto nanosPer = [](chrono::high_resolution_clock::time_point start, size_t count) {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count() / static_cast<long long>(count);
+    };
+    for(int run = 0; run < warmup + repeat; run++) {
+        auto start = chrono::high_resolution_clock::now();
+        Map map(keys);
+        for(size_t i = 0; i < result.upserts; i++)
+            map.insert(names[i % keys], cases[i]);
+        long long mapInsertTime = nanosPer(start, result.upserts);
+
+        start = chrono::high_resolution_clock::now();
+        BTree tree(keys);
+        for(size_t i = 0; i < result.upserts; i++)
+            tree.insert(names[i % keys], cases[i]);
+        long long btreeInsertTime = nanosPer(start, result.upserts);
+
+        start = chrono::high_resolution_clock::now();
+        mapSum = 0;
+        for(const string& name : names)
+            mapSum += map.getCases(name);
+        long long mapLookupTime = nanosPer(start, keys);
+
+        start = chrono::high_resolution_clock::now();
+        btreeSum = 0;
+        for(const string& name : names)
+            btreeSum += tree.getCases(name);
+        long long btreeLookupTime = nanosPer(start, keys);
+
+        sorted.clear();
+        tree.forEach([&](string_view key, long long total) { sorted.emplace_back(key, total); });
+        start = chrono::high_resolution_clock::now();
+        BTree loaded;
+        loaded.bulkLoad(sorted);
+        long long btreeBulkTime = nanosPer(start, keys);
+        if(loaded.totalCases != map.totalCases || tree.totalCases != map.totalCases)
+            mismatch = true;
+        if(run < warmup)
+            continue;
+        mapInsert.push_back(mapInsertTime);
+        btreeInsert.push_back(btreeInsertTime);
+        btreeBulk.push_back(btreeBulkTime);
+        mapLookup.push_back(mapLookupTime);
+        btreeLookup.push_back(btreeLookupTime);
+    }
+    if(mapSum != btreeSum) {
+        cerr << "Lookups on " << keys << " keys disagree: " << mapSum << " on the map, " << btreeSum << " on the B+-tree" << endl;
+        mismatch = true;
+    }
+    result.mapInsertNanos = percentile(mapInsert, 0.5);
+    result.btreeInsertNanos = percentile(btreeInsert, 0.5);
+    result.btreeBulkNanos = percentile(btreeBulk, 0.5);
+    result.mapLookupNanos = percentile(mapLookup, 0.5);
+    result.btreeLookupNanos = percentile(btreeLookup, 0.5);
+    result.checksum = mapSum;
+    cerr << keys << (spreadPrefix ? " hashed prefix" : " shared prefix") << " keys upsert: map " << result.mapInsertNanos << " ns, btree " << result.btreeInsertNanos << " ns, bulk "
+         << result.btreeBulkNanos << " ns  lookup: map " << result.mapLookupNanos << " ns, btree " << result.btreeLookupNanos << " ns" << endl;
+    return result;
+}
+
+static void writeJson(ostream& out, const vector<BenchResult>& results, const vector<QueryResult>& queries,
+                      const vector<TreeResult>& trees, int repeat, int warmup, bool useSnapshot) {
+    out << "{\n";
+    out << "  \"repeat\": " << repeat << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"snapshot\": " << (useSnapshot ? "true" : "false") << ",\n";
+    out << "  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        long long median = percentile(r.total, 0.5);
+        out << "    {\n";
+        out << "      \"file\": \"" << fs::path(r.file).filename().string() << "\",\n";
+        out << "      \"rows\": " << r.rows << ",\n";
+        out << "      \"keys\": " << r.keys << ",\n";
+        out << "      \"backend\": \"" << BACKEND_NAMES[r.backend] << "\",\n";
+        out << "      \"medianMicros\": " << median << ",\n";
+        out << "      \"p99Micros\": " << percentile(r.total, 0.99) << ",\n";
+        out << "      \"minMicros\": " << *min_element(r.total.begin(), r.total.end()) << ",\n";
+        out << "      \"medianLoadMicros\": " << percentile(r.load, 0.5) << ",\n";
+        out << "      \"medianRetrievalMicros\": " << percentile(r.retrieval, 0.5) << ",\n";
+        out << "      \"rowsPerSecond\": " << (median > 0 ? static_cast<long long>(r.rows * 1e6 / median) : 0) << ",\n";
+        out << "      \"peakResidentBytes\": " << r.peakBytes << ",\n";
+        out << "      \"peakIsolated\": " << (r.peakIsolated ? "true" : "false") << ",\n";
+        out << "      \"allocations\": " << r.allocations << ",\n";
+        out << "      \"totalCases\": " << r.totalCases << "\n";
+        out << "    }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"queries\": [\n";
+    for(size_t i = 0; i < queries.size(); i++) {
+        const QueryResult& q = queries[i];
+        out << "    {\"keys\": " << q.keys << ", \"query\": \"" << q.query << "\", \"mapNanos\": " << q.mapNanos
+            << ", \"sortedVectorNanos\": " << q.vectorNanos << ", \"checksum\": " << q.checksum << "}"
+            << (i + 1 < queries.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"trees\": [\n";
+    for(size_t i = 0; i < trees.size(); i++) {
+        const TreeResult& t = trees[i];
+        auto perSecond = [](long long nanos) { return nanos > 0 ? static_cast<long long>(1e9 / nanos) : 0; };
+        out << "    {\"keys\": " << t.keys << ", \"keyPrefix\": \"" << (t.spreadPrefix ? "hashed" : "shared") << "\", \"upserts\": " << t.upserts
+            << ", \"mapUpsertsPerSecond\": " << perSecond(t.mapInsertNanos) << ", \"btreeUpsertsPerSecond\": " << perSecond(t.btreeInsertNanos)
+            << ", \"btreeBulkKeysPerSecond\": " << perSecond(t.btreeBulkNanos)
+            << ", \"mapLookupNanos\": " << t.mapLookupNanos << ", \"btreeLookupNanos\": " << t.btreeLookupNanos
+            << ", \"checksum\": " << t.checksum << "}" << (i + 1 < trees.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> rowCounts = {1000000}, keyCounts = {55, 3200}, treeKeyCounts = {50, 3000, 1000000};
+    int repeat = 7, warmup = 2;
+    int onlyBackend = -1;
+    string dir = (fs::temp_directory_path() / "project3-bench").string(), output, tracePath;
+    bool keep = false;
+    bool useSnapshot = false;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if(arg == "--keep") {
+            keep = true;
+            continue;
+        }
+        if(arg == "--snapshot") {
+            useSnapshot = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        bool valid = true;
+        if(arg == "--rows")
+            valid = parseCounts(value, rowCounts);
+        else if(arg == "--keys")
+            valid = parseCounts(value, keyCounts);
+        else if(arg == "--tree-keys")
+            valid = parseCounts(value, treeKeyCounts);
+        else if(arg == "--repeat")
+            valid = (repeat = atoi(value.c_str())) > 0;
+        else if(arg == "--warmup")
+            valid = (warmup = atoi(value.c_str())) >= 0;
+        else if(arg == "--backend")
+            valid = (onlyBackend = backendFromName(value)) >= 0;
+        else if(arg == "--dir")
+            dir = value;
+        else if(arg == "--output")
+            output = value;
+        else if(arg == "--trace")
+            tracePath = value;
+        else
+            valid = false;
+        if(!valid) {
+            cerr << "Invalid option " << arg << " " << value << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(!tracePath.empty())
+        setTracing(true);
+    error_code error;
+    fs::create_directories(dir, error);
+    vector<string> stateStrings(begin(STATE_NAMES), end(STATE_NAMES));
+    vector<BenchResult> results;
+    bool mismatch = false;
+    for(size_t rows : rowCounts) {
+        for(size_t keys : keyCounts) {
+            string path = (fs::path(dir) / ("bench-" + to_string(rows) + "-" + to_string(keys) + ".csv")).string();
+            if(!fs::exists(path, error)) {
+                cerr << "Generating " << path << endl;
+                if(!generateFile(path, rows, keys)) {
+                    cerr << "Error writing " << path << endl;
+                    return 1;
+                }
+            }
+            long long expected = -1;
+            for(int b = 0; b < BACKENDS; b++) {
+                if(onlyBackend >= 0 && b != onlyBackend)
+                    continue;
+                BenchResult result;
+                result.file = path;
+                result.rows = rows;
+                result.keys = keys;
+                result.backend = static_cast<Backend>(b);
+                result.peakIsolated = resetPeakResidentBytes();
+                for(int run = 0; run < warmup + repeat; run++) {
+                    auto start = chrono::high_resolution_clock::now();
+                    AggregateResult aggregated = aggregate(result.backend, path, stateStrings, useSnapshot);
+                    long long micros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+                    if(!aggregated.ok) {
+                        cerr << "Error opening " << path << endl;
+                        return 1;
+                    }
+                    result.totalCases = aggregated.totalCases;
+                    result.allocations = aggregated.allocations;
+                    if(run < warmup)//warmup runs fault the file into the page cache and are not counted
+                        continue;
+                    result.total.push_back(micros);
+                    result.load.push_back(aggregated.loadMicros);
+                    result.retrieval.push_back(aggregated.retrievalMicros);
+                }
+                result.peakBytes = peakResidentBytes();
+                if(expected >= 0 && result.totalCases != expected) {
+                    cerr << BACKEND_NAMES[b] << " counted " << result.totalCases << " cases in " << path << ", expected " << expected << endl;
+                    mismatch = true;
+                }
+                expected = result.totalCases;
+                cerr << fs::path(path).filename().string() << " " << BACKEND_NAMES[b] << ": median "
+                     << percentile(result.total, 0.5) << " us" << endl;
+                results.push_back(move(result));
+            }
+            if(!keep) {
+                fs::remove(path, error);
+                fs::remove(snapshotPath(path), error);
+            }
+        }
+    }
+
+    if(!tracePath.empty() && !writeChromeTrace(tracePath)) {
+        cerr << "Error writing " << tracePath << endl;
+        return 1;
+    }
+    vector<QueryResult> queries;
+    if(onlyBackend < 0 || onlyBackend == MAP) {
+        for(size_t keys : keyCounts) {
+            vector<QueryResult> timed = benchQueries(keys, repeat, warmup, mismatch);
+            queries.insert(queries.end(), timed.begin(), timed.end());
+        }
+    }
+    vector<TreeResult> trees;
+    if(onlyBackend < 0 || onlyBackend == MAP || onlyBackend == BTREE) {
+        for(size_t keys : treeKeyCounts) {
+            trees.push_back(benchTrees(keys, false, repeat, warmup, mismatch));
+            trees.push_back(benchTrees(keys, true, repeat, warmup, mismatch));
+        }
+    }
+
+    if(output.empty())
+        writeJson(cout, results, queries, trees, repeat, warmup, useSnapshot);
+    else {
+        ofstream out(output);
+        writeJson(out, results, queries, trees, repeat, warmup, useSnapshot);
+        if(!out.good()) {
+            cerr << "Error writing " << output << endl;
+            return 1;
+        }
+    }
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+#include "CasesFile.h"
+
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() {
+    this->data = nullptr;
+    this->length = 0;
+    this->opened = false;
+#ifdef _WIN32
+    this->fileHandle = nullptr;
+    this->mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::MappedFile(const string& path) : MappedFile() {
+    open(path);
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() {
+    *this = move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other) {
+        close();
+        swap(this->data, other.data);
+        swap(this->length, other.length);
+        swap(this->opened, other.opened);
+#ifdef _WIN32
+        swap(this->fileHandle, other.fileHandle);
+        swap(this->mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+bool MappedFile::open(const string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    this->fileHandle = file;
+    this->opened = true;
+    if(fileSize.QuadPart == 0) // Zero length files cannot be mapped on Windows
+        return true;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr) {
+        close();
+        return false;
+    }
+    this->mappingHandle = mapping;
+    this->data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(this->data == nullptr) {
+        close();
+        return false;
+    }
+    this->length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    this->opened = true;
+    if(info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED) {
+            ::close(fd);
+            this->opened = false;
+            return false;
+        }
+        madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL); // Rows are scanned front to back
+        this->data = static_cast<const char*>(mapped);
+        this->length = static_cast<size_t>(info.st_size);
+    }
+    ::close(fd); // The mapping keeps its own reference to the file
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if(this->data != nullptr)
+        UnmapViewOfFile(this->data);
+    if(this->mappingHandle != nullptr)
+        CloseHandle(this->mappingHandle);
+    if(this->fileHandle != nullptr)
+        CloseHandle(this->fileHandle);
+    this->fileHandle = nullptr;
+    this->mappingHandle = nullptr;
+#else
+    if(this->data != nullptr)
+        munmap(const_cast<char*>(this->data), this->length);
+#endif
+    this->data = nullptr;
+    this->length = 0;
+    this->opened = false;
+}
+
+bool CasesFile::open(const string& path) {
+    this->rowsBegin = nullptr;
+    if(!this->file.open(path))
+        return false;
+    if(this->file.size() == 0) {
+        this->rowsBegin = this->file.end();
+        return true;
+    }
+    const char* newline = static_cast<const char*>(memchr(this->file.begin(), '\n', this->file.size()));
+    this->rowsBegin = newline != nullptr ? newline + 1 : this->file.end(); // Skip header line
+    return true;
+}
+
+size_t CasesFile::estimateRows() const {
+    const size_t sampleSize = 64 * 1024; // Bytes read to measure the average line length
+    size_t available = static_cast<size_t>(end() - begin());
+    size_t sample = available < sampleSize ? available : sampleSize;
+    size_t lines = 0;
+    for(const char* p = begin(); p < begin() + sample; p++)
+        lines += *p == '\n';
+    if(lines == 0)
+        return available > 0 ? 1 : 0;
+    size_t estimate = available / (sample / lines);
+    return estimate + estimate / 16 + 1; // Headroom so slightly longer lines later on do not force a stack to grow
+}
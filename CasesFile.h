@@ -0,0 +1,149 @@
+#ifndef CASESFILE_H
+#define CASESFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CASESFILE_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Read-only memory mapping of a whole file, unmapped when destroyed
+class MappedFile {
+    const char* data; // First byte of the mapping, nullptr if the file could not be mapped
+    size_t length; // Size of the mapping in bytes
+    bool opened; // Whether open() succeeded, an empty file maps no memory but is still open
+#ifdef _WIN32
+    void* fileHandle; // HANDLE of the open file
+    void* mappingHandle; // HANDLE of the file mapping object
+#endif
+    void close(); // Unmap the file and release handles
+public:
+    MappedFile(); // Constructor, creates an unopened mapping
+    explicit MappedFile(const std::string& path); // Constructor, maps the file at path
+    ~MappedFile(); // Destructor, unmaps the file
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path); // Map the file at path, returns whether it succeeded
+    bool isOpen() const { return opened; }
+    const char* begin() const { return data; }
+    const char* end() const { return data + length; }
+    size_t size() const { return length; }
+};
+
+// One row of cases.csv (date,county,state,fips,cases,deaths), views point into the mapped file
+struct CaseRow {
+    std::string_view date;
+    std::string_view county;
+    std::string_view state;
+    std::string_view fips;
+    int cases;
+    int deaths;
+};
+
+// Return pointer to the first ',' or '\n' in [p, end), or end if there is none
+inline const char* findFieldEnd(const char* p, const char* end) {
+#ifdef CASESFILE_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while(end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, newline)));
+        if(mask != 0) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+#else
+            return p + __builtin_ctz(mask);
+#endif
+        }
+        p += 16;
+    }
+#endif
+    while(p < end && *p != ',' && *p != '\n')
+        p++;
+    return p;
+}
+
+// Parse a non-negative or negative decimal integer without allocating, anything else parses as 0
+inline int parseInt(std::string_view field) {
+    size_t i = 0;
+    bool negative = false;
+    if(!field.empty() && field[0] == '-') {
+        negative = true;
+        i = 1;
+    }
+    int value = 0;
+    for(; i < field.size(); i++) {
+        unsigned digit = static_cast<unsigned>(field[i] - '0');
+        if(digit > 9)
+            break;
+        value = value * 10 + static_cast<int>(digit);
+    }
+    return negative ? -value : value;
+}
+
+// Split the rows in [begin, end) in place and call onRow(const CaseRow&) for each, returns the number of rows
+template <class F>
+size_t forEachRow(const char* begin, const char* end, F&& onRow) {
+    size_t rows = 0;
+    const char* p = begin;
+    std::string_view fields[6];
+    while(p < end) {
+        int count = 0;
+        for(;;) {
+            const char* fieldEnd = findFieldEnd(p, end);
+            if(count < 6)
+                fields[count++] = std::string_view(p, fieldEnd - p);
+            p = fieldEnd + 1;
+            if(fieldEnd == end || *fieldEnd == '\n')
+                break;
+        }
+        std::string_view& last = fields[count - 1];
+        if(!last.empty() && last.back() == '\r') // Tolerate CRLF line endings
+            last.remove_suffix(1);
+        if(count < 5) // Skip blank or truncated lines
+            continue;
+
+        CaseRow row;
+        row.date = fields[0];
+        row.county = fields[1];
+        row.state = fields[2];
+        row.fips = fields[3];
+        row.cases = parseInt(fields[4]);
+        row.deaths = count > 5 ? parseInt(fields[5]) : 0;
+        onRow(row);
+        rows++;
+    }
+    return rows;
+}
+
+// cases.csv mapped into memory, rows are parsed in place from the mapping
+class CasesFile {
+    MappedFile file; // Mapping of the whole csv file
+    const char* rowsBegin; // First byte after the header line
+public:
+    CasesFile() { rowsBegin = nullptr; }
+    explicit CasesFile(const std::string& path) { rowsBegin = nullptr; open(path); }
+
+    bool open(const std::string& path); // Map the file and skip its header line, returns whether it succeeded
+    bool isOpen() const { return file.isOpen(); }
+    const char* begin() const { return rowsBegin; } // First byte of the data rows
+    const char* end() const { return file.end(); } // One past the last byte of the file
+    size_t size() const { return file.size(); } // Size of the whole file in bytes
+    size_t estimateRows() const; // Guess the number of data rows from the line lengths at the start of the file
+
+    template <class F>
+    size_t forEachRow(F&& onRow) const { return ::forEachRow(begin(), end(), onRow); } // Parse every data row
+};
+
+#endif
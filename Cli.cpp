@@ -0,0 +1,318 @@
+#include "Cli.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Aggregate.h"
+#include "FileWatcher.h"
+#include "Heatmap.h"
+#include "Json.h"
+#include "QueryServer.h"
+#include "QueryService.h"
+#include "Trace.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static void printUsage(const char* program) {
+    cout << "Usage:\n"
+         << "  " << program << "                         open the interactive heatmap window\n"
+         << "  " << program << " --input <cases.csv> --output <map.png> [--totals <totals.json>] [--backend <name>]\n"
+         << "  " << program << " --batch <directory> --output <directory> [--backend <name>]\n"
+         << "  " << program << " --serve <port>|unix:<path> [--input <cases.csv>] [--threads <n>]\n"
+         << "Add --snapshot to read each csv from a binary snapshot next to it, written on the first run.\n"
+         << "Add --scale <name> and --palette <name> to choose the colors.\n"
+         << "Add --trace <trace.json> to write the time of every stage as Chrome trace-event JSON.\n"
+         << "Backends:";
+    for(int i = 0; i < BACKENDS; i++)
+        cout << " " << BACKEND_NAMES[i];
+    cout << " (default hash)\nScales:";
+    for(int i = 0; i < COLOR_SCALES; i++)
+        cout << " " << COLOR_SCALE_NAMES[i];
+    cout << " (default linear)\nPalettes:";
+    for(int i = 0; i < PALETTES; i++)
+        cout << " " << PALETTE_NAMES[i];
+    cout << " (default heat)\n"
+         << "Totals are written as JSON, next to the image with a .json extension unless --totals is given.\n"
+         << "Batch mode renders every .csv file in the directory to <name>.png and <name>.json in the output directory.\n"
+         << "Serve mode loads the input (default cases.csv) once and answers HTTP GET requests on 127.0.0.1:<port> or a\n"
+         << "Unix socket until interrupted, reloading when the file changes. GET /help lists the routes." << endl;
+}
+
+// Write the per-state totals of one run as JSON
+static bool writeTotals(const string& path, const string& input, Backend backend, const vector<string>& stateStrings,
+                        const AggregateResult& result) {
+    ofstream out(path);
+    if(!out.is_open())
+        return false;
+    out << "{\n";
+    out << "  \"input\": \"" << jsonEscape(fs::path(input).filename().string()) << "\",\n";
+    out << "  \"backend\": \"" << BACKEND_NAMES[backend] << "\",\n";
+    out << "  \"rows\": " << result.rows << ",\n";
+    out << "  \"totalCases\": " << result.totalCases << ",\n";
+    out << "  \"loadMicros\": " << result.loadMicros << ",\n";
+    out << "  \"retrievalMicros\": " << result.retrievalMicros << ",\n";
+    out << "  \"states\": {\n";
+    for(size_t i = 0; i < stateStrings.size(); i++)
+        out << "    \"" << jsonEscape(stateStrings[i]) << "\": " << result.stateCases[i] << (i + 1 < stateStrings.size() ? ",\n" : "\n");
+    out << "  }\n}\n";
+    return out.good();
+}
+
+// Aggregate one file and write its heatmap and totals, returns whether every step succeeded
+static bool renderOne(HeatmapRenderer& renderer, sf::RenderTexture& canvas, Backend backend, bool useSnapshot,
+                      const vector<string>& stateStrings, const string& input, const string& image, const string& totals) {
+    AggregateResult result = aggregate(backend, input, stateStrings, useSnapshot);
+    if(!result.ok) {
+        cout << "Error opening " << input << endl;
+        return false;
+    }
+    if(!renderer.renderToFile(canvas, result.stateCases, image)) {
+        cout << "Error writing " << image << endl;
+        return false;
+    }
+    if(!writeTotals(totals, input, backend, stateStrings, result)) {
+        cout << "Error writing " << totals << endl;
+        return false;
+    }
+    cout << input << ": " << result.rows << " rows, load " << result.loadMicros << " us, retrieval "
+         << result.retrievalMicros << " us -> " << image << endl;
+    return true;
+}
+
+// Render the single input file or every file in batch, returns the exit status
+static int runRenders(const string& input, const string& batch, const string& output, string totals, Backend backend,
+                      bool useSnapshot, ColorScale scale, Palette palette) {
+    vector<string> stateStrings(begin(STATE_NAMES), end(STATE_NAMES));
+    ResourceCache cache;//textures are loaded once and shared by every file
+    HeatmapRenderer renderer(cache);
+    renderer.setScale(scale, palette);
+    if(!cache.load()) {
+        cout << "Error loading map images, run from the directory containing images/" << endl;
+        return 1;
+    }
+    sf::RenderTexture canvas;//offscreen target, no window is opened
+    if(!canvas.create(MAP_WIDTH, MAP_HEIGHT)) {
+        cout << "Error creating offscreen render target" << endl;
+        return 1;
+    }
+
+    if(!input.empty()) {
+        if(totals.empty())
+            totals = fs::path(output).replace_extension(".json").string();
+        return renderOne(renderer, canvas, backend, useSnapshot, stateStrings, input, output, totals) ? 0 : 1;
+    }
+
+    error_code error;
+    if(!fs::is_directory(batch, error)) {
+        cout << batch << " is not a directory" << endl;
+        return 1;
+    }
+    fs::create_directories(output, error);
+    vector<fs::path> files;
+    for(const auto& entry : fs::directory_iterator(batch, error)) {
+        if(entry.is_regular_file() && entry.path().extension() == ".csv")
+            files.push_back(entry.path());
+    }
+    sort(files.begin(), files.end());//daily files are processed in name (date) order
+
+    int failures = 0;
+    for(const auto& file : files) {
+        fs::path stem = fs::path(output) / file.stem();
+        if(!renderOne(renderer, canvas, backend, useSnapshot, stateStrings, file.string(), stem.string() + ".png", stem.string() + ".json"))
+            failures++;
+    }
+    cout << files.size() - failures << " of " << files.size() << " files rendered" << endl;
+    return failures == 0 ? 0 : 1;
+}
+
+static QueryServer* activeServer = nullptr;//server stopped by SIGINT and SIGTERM
+
+static void stopServer(int) {
+    if(activeServer != nullptr)
+        activeServer->stop();
+}
+
+// Serve input on a localhost port or unix:<path> until interrupted, returns the exit status
+static int runServe(const string& input, const string& where, unsigned threads) {
+    QueryService service(input);
+    if(!service.reload()) {
+        cout << "Error opening " << input << endl;
+        return 1;
+    }
+    ResourceCache cache;
+    HeatmapRenderer renderer(cache);
+    sf::RenderTexture canvas;//one offscreen target shared by every worker, taking turns
+    mutex renderMutex;
+    //SFML 2.5 images can only be encoded to a file, so each render goes through one temporary file. mkstemps creates
+    //it with a unique name and owner-only access, nobody else can put a file or symlink there first
+    string pngPath = (fs::temp_directory_path() / "project3-serve-XXXXXX.png").string();
+#ifdef _WIN32
+    pngPath.clear();//the server needs Linux anyway
+#else
+    int pngFd = mkstemps(&pngPath[0], 4);//the .png suffix picks SFML's encoder
+    if(pngFd >= 0)
+        close(pngFd);
+    else
+        pngPath.clear();
+#endif
+    auto removePng = [&]() {//on every return from here on
+        error_code error;
+        if(!pngPath.empty())
+            fs::remove(pngPath, error);
+    };
+    if(pngPath.empty())
+        cout << "Error creating a temporary file, /heatmap.png is disabled" << endl;
+    else if(cache.load() && canvas.create(MAP_WIDTH, MAP_HEIGHT)) {
+        canvas.setActive(false);//released so a worker thread can make it current
+        service.setEncoder([&](const long long* stateCases, ColorScale scale, Palette palette, string& png) {
+            lock_guard<mutex> lock(renderMutex);
+            renderer.setScale(scale, palette);
+            bool rendered = renderer.renderToFile(canvas, vector<long long>(stateCases, stateCases + STATE_COUNT), pngPath);
+            canvas.setActive(false);
+            ifstream file(pngPath, ios::binary);
+            png.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+            return rendered && !png.empty();
+        });
+    }
+    else
+        cout << "Map images not found, /heatmap.png is disabled" << endl;
+
+    QueryServer server([&](const QueryRequest& request) { return service.handle(request); }, threads);
+    service.setServerStats(&server.stats);
+    server.setVersion(service.version());
+    bool isUnix = where.compare(0, 5, "unix:") == 0;
+    int port = isUnix ? 0 : atoi(where.c_str());
+    if(!isUnix && (port <= 0 || port >= 65536 || where.find_first_not_of("0123456789") != string::npos)) {
+        cout << "Invalid port " << where << endl;
+        removePng();
+        return 1;
+    }
+    if(!(isUnix ? server.listenUnix(where.substr(5)) : server.listenTcp(static_cast<uint16_t>(port)))) {
+        cout << server.getError() << endl;
+        removePng();
+        return 1;
+    }
+
+    atomic<bool> serving(true);
+    thread reloader([&]() {//new rows are ingested off the event loop, requests keep the dataset they started with
+        FileWatcher watcher(input);
+        while(serving) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            if(watcher.changed() && service.reload())
+                server.setVersion(service.version());//after the data is published, so nothing is cached under a version newer than its data
+        }
+    });
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cout << "Serving " << input << " on " << (isUnix ? where.substr(5) : "http://127.0.0.1:" + where)
+         << ", press Ctrl+C to stop" << endl;
+    server.run();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    activeServer = nullptr;
+    serving = false;
+    reloader.join();
+    removePng();
+    cout << server.stats.requests << " requests served, " << server.stats.cacheHits << " from the cache" << endl;
+    return 0;
+}
+
+int runCli(int argc, char* argv[]) {
+    string input, batch, output, totals, tracePath, serve;
+    unsigned threads = 0;
+    Backend backend = HASH;
+    bool useSnapshot = false;
+    ColorScale scale = LINEAR_SCALE;
+    Palette palette = HEAT_PALETTE;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if(arg == "--snapshot") {
+            useSnapshot = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            cout << "Missing value for " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        if(arg == "--input")
+            input = value;
+        else if(arg == "--batch")
+            batch = value;
+        else if(arg == "--output")
+            output = value;
+        else if(arg == "--totals")
+            totals = value;
+        else if(arg == "--trace")
+            tracePath = value;
+        else if(arg == "--serve")
+            serve = value;
+        else if(arg == "--threads") {
+            int count = atoi(value.c_str());
+            if(count <= 0) {
+                cout << "Invalid thread count " << value << endl;
+                return 1;
+            }
+            threads = static_cast<unsigned>(count);
+        }
+        else if(arg == "--backend") {
+            int found = backendFromName(value);
+            if(found < 0) {
+                cout << "Unknown backend " << value << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            backend = static_cast<Backend>(found);
+        }
+        else if(arg == "--scale" || arg == "--palette") {
+            int found = arg == "--scale" ? colorScaleFromName(value) : paletteFromName(value);
+            if(found < 0) {
+                cout << "Unknown " << arg.substr(2) << " " << value << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            if(arg == "--scale")
+                scale = static_cast<ColorScale>(found);
+            else
+                palette = static_cast<Palette>(found);
+        }
+        else {
+            cout << "Unknown option " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(serve.empty() && (output.empty() || input.empty() == batch.empty())) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if(!tracePath.empty())
+        setTracing(true);
+    int status = serve.empty() ? runRenders(input, batch, output, totals, backend, useSnapshot, scale, palette)
+            : runServe(input.empty() ? "cases.csv" : input, serve, threads);
+    if(!tracePath.empty() && !writeChromeTrace(tracePath)) {
+        cout << "Error writing " << tracePath << endl;
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,7 @@
+#ifndef CLI_H
+#define CLI_H
+
+// Run the headless command line mode, which aggregates and renders heatmaps without opening a window
+int runCli(int argc, char* argv[]);
+
+#endif
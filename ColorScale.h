@@ -0,0 +1,40 @@
+#ifndef COLORSCALE_H
+#define COLORSCALE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLORSCALE_SSE2 1
+#endif
+
+// How region values are spread over a palette
+enum ColorScale { LINEAR_SCALE, LOG_SCALE, QUANTILE_SCALE, COLOR_SCALES };
+
+const char* const COLOR_SCALE_NAMES[COLOR_SCALES] = {"linear", "log", "quantile"}; // Command line and GUI names, indexed by ColorScale
+
+// Palettes a scale maps onto, every one runs from light for the lowest values to dark for the highest
+enum Palette { HEAT_PALETTE, VIRIDIS_PALETTE, MAGMA_PALETTE, PALETTES };
+
+const char* const PALETTE_NAMES[PALETTES] = {"heat", "viridis", "magma"}; // Command line and GUI names, indexed by Palette
+
+const int PALETTE_SIZE = 256; // Entries in each palette's lookup table
+
+int colorScaleFromName(std::string_view name); // Return the ColorScale called name, -1 if there is none
+int paletteFromName(std::string_view name); // Return the Palette called name, -1 if there is none
+
+// Pack a color as RGBA bytes in memory order, the layout of sf::Color and of texture pixels
+inline uint32_t packColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255) {
+    return red | (green << 8) | (blue << 16) | (static_cast<uint32_t>(alpha) << 24);
+}
+
+const uint32_t* paletteColors(Palette palette); // The palette's PALETTE_SIZE packed colors, lowest first
+
+/* Color count values in one pass, writing one packed color per value. Linear and log scales are relative to the
+ * largest value, quantile to each value's rank among the others, and values <= 0 get the palette's lowest color.
+ * The linear and log scales run four values at a time with SSE2 when it is available.
+ */
+void mapColors(const long long* values, size_t count, ColorScale scale, Palette palette, uint32_t* colors);
+
+#endif
@@ -0,0 +1,301 @@
+#include "Counties.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include "BackgroundLoad.h"
+
+using namespace std;
+
+void CountyCounter::clear() {
+    fill(this->cases.begin(), this->cases.end(), 0);
+    this->totalCases = 0;
+    this->countyCases = 0;
+    this->rows = 0;
+}
+
+bool CountyCounter::load(const string& path, LoadProgress* progress) {
+    auto start = chrono::high_resolution_clock::now();
+    CasesFile casesFile(path);
+    if(!casesFile.isOpen())
+        return false;
+    clear();
+    if(progress != nullptr)
+        progress->bytesTotal = static_cast<size_t>(casesFile.end() - casesFile.begin());
+    this->rows = forEachRowReporting(casesFile.begin(), casesFile.end(), progress, [&](const CaseRow& row) {
+        add(row.fips, row.cases);
+    });
+    this->loadMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+CountyMap::CountyMap() : buffer(sf::Triangles, sf::VertexBuffer::Stream) {
+    this->useBuffer = false;
+    this->useShader = false;
+    this->columns = 0;
+    this->gridRows = 0;
+}
+
+// Read one little-endian uint32, returns whether it was there
+static bool readUint(ifstream& in, uint32_t& value) {
+    unsigned char bytes[4];
+    if(!in.read(reinterpret_cast<char*>(bytes), 4))
+        return false;
+    value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    return true;
+}
+
+// Read one little-endian float, returns whether it was there
+static bool readFloat(ifstream& in, float& value) {
+    uint32_t bits;
+    if(!readUint(in, bits))
+        return false;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+// Twice the signed area of triangle abc, positive when it turns counterclockwise in y-up coordinates
+static float cross(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+void CountyMap::tessellate(Region& region) {
+    region.firstVertex = static_cast<uint32_t>(this->vertices.size());
+    for(uint32_t r = region.firstRing; r < region.firstRing + region.ringCount; r++) {
+        const sf::Vector2f* ring = &this->points[this->rings[r].first];
+        vector<uint32_t> left(this->rings[r].second);//points not yet cut off as an ear
+        for(uint32_t i = 0; i < left.size(); i++)
+            left[i] = i;
+        float area = 0;
+        for(size_t i = 0; i < left.size(); i++)
+            area += cross({0, 0}, ring[i], ring[(i + 1) % left.size()]);
+        if(area < 0)//clip ears in counterclockwise order
+            reverse(left.begin(), left.end());
+
+        auto emit = [&](uint32_t a, uint32_t b, uint32_t c) {
+            this->vertices.emplace_back(ring[a]);
+            this->vertices.emplace_back(ring[b]);
+            this->vertices.emplace_back(ring[c]);
+        };
+        /* Cut off one convex corner with no other point inside it at a time. The points left form a linked ring, so
+         * a clip is constant time and the scan carries on from the corner that was clipped, stepping back one point
+         * since that corner changed. Each test walks the ring, so a ring of n points takes about n * n steps.
+         */
+        size_t count = left.size();
+        vector<uint32_t> next(count), prev(count);//neighbours of each position in left
+        for(size_t i = 0; i < count; i++) {
+            next[i] = static_cast<uint32_t>((i + 1) % count);
+            prev[i] = static_cast<uint32_t>((i + count - 1) % count);
+        }
+        uint32_t i = 0;
+        size_t failures = 0;//corners tested in a row without a clip
+        while(count > 3 && failures < count) {//a whole lap without a clip means a self-intersecting ring
+            uint32_t a = left[prev[i]], b = left[i], c = left[next[i]];
+            bool ear = cross(ring[a], ring[b], ring[c]) > 0;//reflex and degenerate corners are not ears
+            for(uint32_t j = next[next[i]]; ear && j != prev[i]; j = next[j]) {
+                uint32_t p = left[j];
+                if(cross(ring[a], ring[b], ring[p]) >= 0 && cross(ring[b], ring[c], ring[p]) >= 0 && cross(ring[c], ring[a], ring[p]) >= 0)
+                    ear = false;
+            }
+            if(!ear) {
+                i = next[i];
+                failures++;
+                continue;
+            }
+            emit(a, b, c);
+            next[prev[i]] = next[i];
+            prev[next[i]] = prev[i];
+            i = prev[i];
+            count--;
+            failures = 0;
+        }
+        for(uint32_t j = next[i]; next[j] != i; j = next[j])//fan out what is left so a self-intersecting ring is still filled
+            emit(left[i], left[j], left[next[j]]);
+    }
+    region.vertexCount = static_cast<uint32_t>(this->vertices.size()) - region.firstVertex;
+}
+
+void CountyMap::buildGrid(int width, int height) {
+    this->columns = (width + CELL_SIZE - 1) / CELL_SIZE;
+    this->gridRows = (height + CELL_SIZE - 1) / CELL_SIZE;
+    auto cellRange = [&](const sf::FloatRect& bounds, int& x0, int& y0, int& x1, int& y1) {
+        x0 = max(0, min(this->columns - 1, static_cast<int>(bounds.left) / CELL_SIZE));
+        y0 = max(0, min(this->gridRows - 1, static_cast<int>(bounds.top) / CELL_SIZE));
+        x1 = max(0, min(this->columns - 1, static_cast<int>(bounds.left + bounds.width) / CELL_SIZE));
+        y1 = max(0, min(this->gridRows - 1, static_cast<int>(bounds.top + bounds.height) / CELL_SIZE));
+    };
+    //count the regions of each cell, then fill every cell's list in one array
+    this->cellStart.assign(static_cast<size_t>(this->columns) * this->gridRows + 1, 0);
+    int x0, y0, x1, y1;
+    for(const Region& region : this->regions) {
+        cellRange(region.bounds, x0, y0, x1, y1);
+        for(int y = y0; y <= y1; y++)
+            for(int x = x0; x <= x1; x++)
+                this->cellStart[y * this->columns + x + 1]++;
+    }
+    for(size_t i = 1; i < this->cellStart.size(); i++)
+        this->cellStart[i] += this->cellStart[i - 1];
+    this->cellRegions.assign(this->cellStart.back(), 0);
+    vector<uint32_t> filled(this->cellStart.begin(), this->cellStart.end() - 1);
+    for(uint32_t i = 0; i < this->regions.size(); i++) {
+        cellRange(this->regions[i].bounds, x0, y0, x1, y1);
+        for(int y = y0; y <= y1; y++)
+            for(int x = x0; x <= x1; x++)
+                this->cellRegions[filled[y * this->columns + x]++] = i;
+    }
+}
+
+bool CountyMap::load(const string& path, int width, int height) {
+    this->regions.clear();
+    this->points.clear();
+    this->rings.clear();
+    this->vertices.clear();
+    ifstream in(path, ios::binary);
+    char magic[4];
+    uint32_t regionCount;
+    if(!in.read(magic, 4) || memcmp(magic, "CTY1", 4) != 0 || !readUint(in, regionCount) || regionCount > FIPS_SLOTS)
+        return false;
+    this->regions.reserve(regionCount);
+    for(uint32_t i = 0; i < regionCount; i++) {
+        Region region;
+        uint32_t fips;
+        if(!readUint(in, fips) || !readUint(in, region.ringCount) || fips >= FIPS_SLOTS) {
+            this->regions.clear();
+            return false;
+        }
+        region.fips = static_cast<int>(fips);
+        region.firstRing = static_cast<uint32_t>(this->rings.size());
+        float minX = width, minY = height, maxX = 0, maxY = 0;
+        for(uint32_t r = 0; r < region.ringCount; r++) {
+            uint32_t count;
+            if(!readUint(in, count)) {
+                this->regions.clear();
+                return false;
+            }
+            uint32_t first = static_cast<uint32_t>(this->points.size());
+            for(uint32_t p = 0; p < count; p++) {
+                sf::Vector2f point;
+                if(!readFloat(in, point.x) || !readFloat(in, point.y)) {
+                    this->regions.clear();
+                    return false;
+                }
+                minX = min(minX, point.x);
+                minY = min(minY, point.y);
+                maxX = max(maxX, point.x);
+                maxY = max(maxY, point.y);
+                this->points.push_back(point);
+            }
+            if(count > 1 && this->points.back().x == this->points[first].x && this->points.back().y == this->points[first].y) {
+                this->points.pop_back();//shapefile rings repeat their first point at the end
+                count--;
+            }
+            this->rings.emplace_back(first, count);
+        }
+        region.bounds = sf::FloatRect(minX, minY, max(0.f, maxX - minX), max(0.f, maxY - minY));
+        tessellate(region);
+        this->regions.push_back(region);
+    }
+    buildGrid(width, height);
+    return true;
+}
+
+void CountyMap::upload() {
+    this->useBuffer = sf::VertexBuffer::isAvailable() && this->buffer.create(this->vertices.size());
+    if(this->useBuffer)
+        this->buffer.update(this->vertices.data());
+}
+
+void CountyMap::setCases(const CountyCounter& counter, ColorScale scale, Palette palette) {
+    this->regionCases.resize(this->regions.size());
+    this->regionColors.resize(this->regions.size());
+    for(size_t i = 0; i < this->regions.size(); i++)
+        this->regionCases[i] = counter.getCases(this->regions[i].fips);
+    mapColors(this->regionCases.data(), this->regionCases.size(), scale, palette, this->regionColors.data());
+    if(this->useShader)//one small texture update, the triangles are recolored if the shader is turned off
+        this->shader.setColors(this->regionColors.data());
+    else
+        applyColors();
+}
+
+void CountyMap::applyColors() {
+    if(this->regionColors.size() != this->regions.size())
+        return;
+    for(size_t i = 0; i < this->regions.size(); i++) {
+        uint32_t c = this->regionColors[i];
+        sf::Color color(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF);
+        for(uint32_t v = this->regions[i].firstVertex; v < this->regions[i].firstVertex + this->regions[i].vertexCount; v++)
+            this->vertices[v].color = color;
+    }
+    if(this->useBuffer)
+        this->buffer.update(this->vertices.data());
+}
+
+bool CountyMap::setShaderEnabled(bool enabled, int width, int height) {
+    if(!enabled) {
+        if(this->useShader) {
+            this->useShader = false;
+            applyColors();
+        }
+        return false;
+    }
+    if(!this->shader.isLoaded() && !this->regions.empty()) {//rasterize every region with its ID as the color
+        sf::RenderTexture canvas;
+        if(!canvas.create(width, height))
+            return false;
+        canvas.clear(sf::Color::Transparent);
+        vector<sf::Vertex> idVertices(this->vertices);
+        for(uint32_t i = 0; i < this->regions.size(); i++) {
+            sf::Color id((i + 1) & 0xFF, (i + 1) >> 8, 255, 255);
+            for(uint32_t v = this->regions[i].firstVertex; v < this->regions[i].firstVertex + this->regions[i].vertexCount; v++)
+                idVertices[v].color = id;
+        }
+        canvas.draw(idVertices.data(), idVertices.size(), sf::Triangles, sf::RenderStates(sf::BlendNone));
+        canvas.display();
+        if(!this->shader.load(canvas.getTexture().copyToImage(), static_cast<int>(this->regions.size())))
+            return false;
+    }
+    this->useShader = this->shader.isLoaded();
+    if(this->useShader && this->regionColors.size() == this->regions.size())
+        this->shader.setColors(this->regionColors.data());
+    return this->useShader;
+}
+
+bool CountyMap::ringContains(uint32_t ring, float x, float y) const {
+    const sf::Vector2f* p = &this->points[this->rings[ring].first];
+    uint32_t count = this->rings[ring].second;
+    bool inside = false;
+    for(uint32_t i = 0, j = count - 1; i < count; j = i++) {
+        if((p[i].y > y) != (p[j].y > y) && x < (p[j].x - p[i].x) * (y - p[i].y) / (p[j].y - p[i].y) + p[i].x)
+            inside = !inside;
+    }
+    return inside;
+}
+
+int CountyMap::regionAt(float x, float y) const {
+    if(x < 0 || y < 0 || this->columns == 0)
+        return -1;
+    int column = static_cast<int>(x) / CELL_SIZE, row = static_cast<int>(y) / CELL_SIZE;
+    if(column >= this->columns || row >= this->gridRows)
+        return -1;
+    int cell = row * this->columns + column;
+    for(uint32_t i = this->cellStart[cell]; i < this->cellStart[cell + 1]; i++) {
+        const Region& region = this->regions[this->cellRegions[i]];
+        if(!region.bounds.contains(x, y))
+            continue;
+        for(uint32_t r = region.firstRing; r < region.firstRing + region.ringCount; r++) {
+            if(this->rings[r].second > 2 && ringContains(r, x, y))
+                return static_cast<int>(this->cellRegions[i]);
+        }
+    }
+    return -1;
+}
+
+void CountyMap::draw(sf::RenderTarget& target) const {
+    if(this->useShader)
+        this->shader.draw(target, static_cast<int>(this->regions.size()));
+    else if(this->useBuffer)
+        target.draw(this->buffer);
+    else if(!this->vertices.empty())
+        target.draw(this->vertices.data(), this->vertices.size(), sf::Triangles);
+}
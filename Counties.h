@@ -0,0 +1,109 @@
+#ifndef COUNTIES_H
+#define COUNTIES_H
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "CasesFile.h"
+#include "ColorScale.h"
+#include "RegionShader.h"
+
+struct LoadProgress;
+
+const int FIPS_SLOTS = 100000; // County FIPS codes are five digits, so every county has its own slot
+const char* const COUNTY_GEOMETRY_FILE = "images/counties.bin"; // Built from real county outlines by MakeCounties.py, not shipped
+const char* const COUNTY_SAMPLE_FILE = "images/counties-sample.bin"; // Synthetic tiles from MakeCounties.py --sample, used when the real file is missing
+
+// Return the five digit county FIPS code of a field, -1 if it is empty or not a code (e.g. "New York City" rows)
+inline int parseFips(std::string_view fips) {
+    if(fips.empty() || fips.size() > 5)
+        return -1;
+    for(char c : fips) {
+        if(c < '0' || c > '9')
+            return -1;
+    }
+    return parseInt(fips);
+}
+
+// Aggregation of cases by county, a dense array indexed by FIPS so each row is one add like the state path
+class CountyCounter {
+    std::vector<long long> cases; // Total cases of each county, indexed by FIPS code
+public:
+    long long totalCases = 0; // Cases of every row, including rows without a FIPS code
+    long long countyCases = 0; // Cases of the rows that have a FIPS code
+    size_t rows = 0; // Number of data rows read
+    long long loadMicros = 0; // Time to map and count the file
+
+    CountyCounter() : cases(FIPS_SLOTS, 0) {}
+
+    void clear(); // Reset every county and the totals to 0
+    void add(std::string_view fips, int cases) { // Add a row's cases to its county, rows without a code only count toward the total
+        int code = parseFips(fips);
+        if(code >= 0) {
+            this->cases[code] += cases;
+            countyCases += cases;
+        }
+        totalCases += cases;
+    }
+    bool load(const std::string& path, LoadProgress* progress = nullptr); // Count every row of the file at path, returns whether it could be opened
+    long long getCases(int fips) const { return cases[fips]; } // Return the number of cases in the county with this FIPS code
+};
+
+/* County outlines, drawn in one call from a single vertex buffer and hit-tested through a uniform grid.
+ *
+ * The geometry file is made offline by MakeCounties.py from a county GeoJSON (such as the Census Bureau's
+ * cartographic boundary file), projected to the pixel coordinates of BWMap.png so the outlines line up with the
+ * state masks. It is little-endian:
+ *   char magic[4] = "CTY1"; uint32 regionCount;
+ *   per region: uint32 fips; uint32 ringCount;
+ *     per ring: uint32 pointCount; float x, y for each point
+ * Every ring is filled as its own polygon, lakes and other holes are not cut out.
+ */
+class CountyMap {
+    struct Region {
+        int fips; // FIPS code of the county
+        uint32_t firstVertex; // First vertex of the region's triangles in vertices
+        uint32_t vertexCount; // Number of triangle vertices of the region
+        uint32_t firstRing; // First of the region's rings in rings
+        uint32_t ringCount; // Number of rings of the region
+        sf::FloatRect bounds; // Bounding box of every ring
+    };
+    std::vector<Region> regions; // Every county in file order
+    std::vector<sf::Vector2f> points; // Outline points of every ring back to back
+    std::vector<std::pair<uint32_t, uint32_t>> rings; // First point and point count of each ring
+    std::vector<sf::Vertex> vertices; // Triangles of every region, recolored in place
+    sf::VertexBuffer buffer; // GPU copy of vertices, updated when the colors change
+    bool useBuffer; // Whether vertex buffers are available, otherwise vertices are drawn from memory
+    std::vector<long long> regionCases; // Cases of each region from the last setCases
+    std::vector<uint32_t> regionColors; // Packed color of each region from the last setCases
+    RegionShader shader; // Per-pixel coloring from a region ID texture, built the first time it is enabled
+    bool useShader; // Whether draw() goes through the shader instead of the triangles
+
+    void applyColors(); // Copy regionColors into the triangles and the vertex buffer
+
+    static const int CELL_SIZE = 32; // Pixels per side of a grid cell
+    int columns, gridRows; // Size of the grid in cells
+    std::vector<uint32_t> cellStart; // Offset in cellRegions of each cell's list, one extra entry at the end
+    std::vector<uint32_t> cellRegions; // Indices of the regions whose bounds overlap each cell, cell by cell
+
+    void tessellate(Region& region); // Ear clip every ring of region into triangles appended to vertices
+    void buildGrid(int width, int height); // Bucket every region's bounds into the grid cells
+    bool ringContains(uint32_t ring, float x, float y) const; // Even-odd test of a point against one ring
+public:
+    CountyMap();
+
+    bool load(const std::string& path, int width, int height); // Read and tessellate the geometry file for a width x height map, safe off the main thread
+    void upload(); // Create the vertex buffer, must run on the thread drawing the map
+    size_t size() const { return regions.size(); } // Number of counties
+    bool isEmpty() const { return regions.empty(); }
+    int fipsOf(int region) const { return regions[region].fips; }
+    void setCases(const CountyCounter& counter, ColorScale scale, Palette palette); // Color every county by its cases in one mapColors batch
+    bool setShaderEnabled(bool enabled, int width, int height); // Switch to or from the shader, returns whether it is now in use
+    int regionAt(float x, float y) const; // Index of the county under a point, -1 if there is none
+    void draw(sf::RenderTarget& target) const; // Draw every county in one call
+};
+
+#endif
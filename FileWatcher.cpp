@@ -0,0 +1,71 @@
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const auto POLL_INTERVAL = chrono::milliseconds(250); // Time between polls when inotify is not available
+
+FileWatcher::FileWatcher(const string& path) : path(path) {
+    error_code error;
+    this->lastSize = fs::file_size(path, error);
+    this->lastTime = fs::last_write_time(path, error);
+    this->lastPoll = chrono::steady_clock::now();
+#ifdef __linux__
+    //watch the directory rather than the file, so a file that is replaced or created later is still seen
+    this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    fs::path directory = fs::path(path).parent_path();
+    if(this->inotifyFd >= 0 && inotify_add_watch(this->inotifyFd, directory.empty() ? "." : directory.c_str(),
+                                                 IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(this->inotifyFd);
+        this->inotifyFd = -1;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if(this->inotifyFd >= 0)
+        close(this->inotifyFd);
+#endif
+}
+
+bool FileWatcher::poll() {
+    error_code error;
+    uintmax_t size = fs::file_size(this->path, error);
+    fs::file_time_type time = fs::last_write_time(this->path, error);
+    bool changed = size != this->lastSize || time != this->lastTime;
+    this->lastSize = size;
+    this->lastTime = time;
+    return changed;
+}
+
+bool FileWatcher::changed() {
+#ifdef __linux__
+    if(this->inotifyFd >= 0) {
+        //drain every pending event, any event about the file counts as one change
+        alignas(inotify_event) char buffer[4096];
+        string name = fs::path(this->path).filename().string();
+        bool touched = false;
+        ssize_t length;
+        while((length = read(this->inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for(char* p = buffer; p < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if(event->len > 0 && name == event->name)
+                    touched = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return touched && poll();//a write of zero bytes is not a change
+    }
+#endif
+    auto now = chrono::steady_clock::now();
+    if(now - this->lastPoll < POLL_INTERVAL)
+        return false;
+    this->lastPoll = now;
+    return poll();
+}
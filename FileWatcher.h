@@ -0,0 +1,28 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Reports when a file is written to, through inotify on Linux and by polling its size and modification time elsewhere
+class FileWatcher {
+    std::string path; // File being watched
+    std::uintmax_t lastSize; // Size at the last poll
+    std::filesystem::file_time_type lastTime; // Modification time at the last poll
+    std::chrono::steady_clock::time_point lastPoll; // When the file was last polled
+#ifdef __linux__
+    int inotifyFd; // Non-blocking inotify instance watching the file's directory, -1 if unavailable
+#endif
+    bool poll(); // Compare the file's size and modification time with the last poll
+public:
+    explicit FileWatcher(const std::string& path);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool changed(); // Whether the file was written to since the last call, never blocks
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "Heatmap.h"
+
+#include <algorithm>
+#include "Trace.h"
+
+using namespace std;
+
+const sf::Vector2i STATE_LOCATIONS[STATE_COUNT] = {{1156,625},{85,752},{299,550},{955,585},{69,323}
+        ,{493,424},{1543,289},{1499,389},{1199,756},{1235,614},{473,905}
+        ,{288,108},{1029,362},{1143,382},{878,332},{710,466},{1114,468},{982,717}
+        ,{1563,72},{1398,396},{1539,247},{1040,184},{850,144},{1065,635}
+        ,{908,448},{357,111},{657,362},{181,343},{1551,166},{1502,331}
+        ,{464,561},{1360,197},{1287,503},{664,141},{1223,351},{675,567}
+        ,{87,174},{1343,313},{1590,287},{1315,592},{662,255},{1094,547}
+        ,{537,584},{339,371},{1505,171},{1295,426},{134,76},{1313,394}
+        ,{979,217},{455,279}};
+
+void HeatmapRenderer::setCases(const long long* stateCases) {
+    mapColors(stateCases, STATE_COUNT, this->scale, this->palette, this->stateColors);
+    this->shader.setColors(this->stateColors);//does nothing until the shader has been enabled
+    for(int i = 0; i < STATE_COUNT; i++) {
+        const sf::IntRect& rect = this->cache.stateRect(i);
+        float left = STATE_LOCATIONS[i].x, top = STATE_LOCATIONS[i].y;
+        uint32_t c = this->stateColors[i];
+        sf::Color color(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF);
+        sf::Vertex* quad = &this->stateQuads[4 * i];
+        quad[0] = sf::Vertex({left, top}, color, sf::Vector2f(rect.left, rect.top));
+        quad[1] = sf::Vertex({left + rect.width, top}, color, sf::Vector2f(rect.left + rect.width, rect.top));
+        quad[2] = sf::Vertex({left + rect.width, top + rect.height}, color, sf::Vector2f(rect.left + rect.width, rect.top + rect.height));
+        quad[3] = sf::Vertex({left, top + rect.height}, color, sf::Vector2f(rect.left, rect.top + rect.height));
+    }
+}
+
+bool HeatmapRenderer::setShaderEnabled(bool enabled) {
+    if(enabled && !this->shader.isLoaded() && RegionShader::isAvailable()) {//stamp every state's mask into an ID image
+        sf::Image atlas = this->cache.stateAtlas().copyToImage();
+        sf::Image ids;
+        ids.create(MAP_WIDTH, MAP_HEIGHT, sf::Color::Transparent);
+        for(int i = 0; i < STATE_COUNT; i++) {
+            const sf::IntRect& rect = this->cache.stateRect(i);
+            for(int y = 0; y < rect.height; y++) {
+                for(int x = 0; x < rect.width; x++) {
+                    int mapX = STATE_LOCATIONS[i].x + x, mapY = STATE_LOCATIONS[i].y + y;
+                    if(mapX < MAP_WIDTH && mapY < MAP_HEIGHT)
+                        RegionShader::setRegion(ids, mapX, mapY, i, atlas.getPixel(rect.left + x, rect.top + y).a);
+                }
+            }
+        }
+        if(this->shader.load(ids, STATE_COUNT))
+            this->shader.setColors(this->stateColors);
+    }
+    this->useShader = enabled && this->shader.isLoaded();
+    return this->useShader;
+}
+
+void HeatmapRenderer::draw(sf::RenderTarget& target, BaseMap base, int visibleStates) const {
+    target.draw(sf::Sprite(this->cache.baseMap(base)));
+    if(this->useShader)//every state in one sprite, colored per pixel
+        this->shader.draw(target, visibleStates);
+    else if(visibleStates > 0)//one call for every state, the atlas is bound once
+        target.draw(&this->stateQuads[0], 4 * min(visibleStates, STATE_COUNT), sf::Quads, &this->cache.stateAtlas());
+}
+
+bool HeatmapRenderer::renderToFile(sf::RenderTexture& canvas, const vector<long long>& stateCases, const string& path) {
+    TRACE_SCOPE("render to file");
+    canvas.clear(sf::Color::White);
+    setCases(stateCases.data());
+    draw(canvas, BLANK_MAP);
+    canvas.display();//finish drawing so the texture is right side up
+    return canvas.getTexture().copyToImage().saveToFile(path);
+}
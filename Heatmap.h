@@ -0,0 +1,43 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+#include "ColorScale.h"
+#include "RegionShader.h"
+#include "ResourceCache.h"
+#include "StateIndex.h"
+
+const int MAP_WIDTH = 1762; // Width of the map images
+const int MAP_HEIGHT = 1271; // Height of the map images
+
+// Found locations so that individual state sprites line up with the map, indexed like STATE_NAMES
+extern const sf::Vector2i STATE_LOCATIONS[STATE_COUNT];
+
+// Draws heatmaps from the textures held by a ResourceCache, every state is one quad cut from the state atlas
+// so all of them go to the GPU in a single draw call, only the vertex colors change between renders.
+// With the shader enabled the states are instead one sprite colored per pixel from a state ID texture
+class HeatmapRenderer {
+    const ResourceCache& cache; // Loaded base maps and state atlas
+    sf::VertexArray stateQuads; // Four vertices per state, indexed like STATE_NAMES
+    uint32_t stateColors[STATE_COUNT]; // Packed color of each state from the last setCases
+    ColorScale scale; // How totals are spread over the palette
+    Palette palette; // Colors the totals map onto
+    RegionShader shader; // Per-pixel coloring, built from the state masks the first time it is enabled
+    bool useShader; // Whether draw() goes through the shader instead of the quads
+public:
+    explicit HeatmapRenderer(const ResourceCache& cache) : cache(cache), stateQuads(sf::Quads, 4 * STATE_COUNT), stateColors(),
+                                                           scale(LINEAR_SCALE), palette(HEAT_PALETTE), useShader(false) {}
+
+    void setScale(ColorScale scale, Palette palette) { this->scale = scale; this->palette = palette; } // Used from the next setCases
+    ColorScale getScale() const { return scale; }
+    Palette getPalette() const { return palette; }
+    bool setShaderEnabled(bool enabled); // Switch to or from the shader, returns whether it is now in use, the cache must be ready
+    void setCases(const long long* stateCases); // Place every state's quad and color all STATE_COUNT totals in one batch, the cache must be ready
+    void draw(sf::RenderTarget& target, BaseMap base, int visibleStates = STATE_COUNT) const; // Draw the base map and the first visibleStates states
+    bool renderToFile(sf::RenderTexture& canvas, const std::vector<long long>& stateCases,
+                      const std::string& path); // Draw offscreen onto canvas and save the result as an image
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "IncrementalIngest.h"
+
+#include <chrono>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#include "BackgroundLoad.h"
+#include "CasesFile.h"
+#include "MemoryStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+const size_t TAIL_BYTES = 64 << 10;//bytes before consumed that are hashed to notice a rewrite
+
+// Device and inode of the file at path, 0 if unknown
+static uint64_t fileIdOf(const string& path) {
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0)
+        return 0;
+    return (static_cast<uint64_t>(info.st_dev) << 40) ^ static_cast<uint64_t>(info.st_ino);
+#endif
+}
+
+// FNV-1a of the TAIL_BYTES before end, or of everything from begin if there are fewer
+static uint64_t tailHashOf(const char* begin, const char* end) {
+    const char* p = static_cast<size_t>(end - begin) > TAIL_BYTES ? end - TAIL_BYTES : begin;
+    uint64_t hash = 14695981039346656037ull;
+    for(; p < end; p++)
+        hash = (hash ^ static_cast<uint8_t>(*p)) * 1099511628211ull;
+    return hash;
+}
+
+IncrementalAggregator::IncrementalAggregator(Backend backend) {
+    this->backend = backend;
+    this->consumed = 0;
+    this->fileId = 0;
+    this->tailHash = 0;
+    this->rewritten = false;
+    this->rows = 0;
+    this->newRows = 0;
+    this->refreshMicros = 0;
+    this->refreshAllocations = 0;
+    this->ok = false;
+}
+
+void IncrementalAggregator::reset() {
+    this->map.clear();
+    this->counter.clear();
+    this->consumed = 0;
+    this->tailHash = 0;
+    this->rows = 0;
+}
+
+size_t IncrementalAggregator::refresh(const string& path, LoadProgress* progress) {
+    auto start = chrono::high_resolution_clock::now();
+    TRACE_SCOPE(BACKEND_NAMES[this->backend]);
+    size_t allocationsBefore = allocationCount();
+    this->refreshStages.clear();
+    this->newRows = 0;
+    this->rewritten = false;
+    TraceScope open("open", &this->refreshStages);
+    CasesFile casesFile(path);//remapped every time, only the pages of new rows are read
+    this->ok = casesFile.isOpen();
+    if(!this->ok)
+        return 0;
+    open.stop();
+    TraceScope build("parse+build", &this->refreshStages);
+    size_t available = static_cast<size_t>(casesFile.end() - casesFile.begin());
+    uint64_t id = fileIdOf(path);
+    if(this->consumed > 0 && (available < this->consumed || id != this->fileId
+            || tailHashOf(casesFile.begin(), casesFile.begin() + this->consumed) != this->tailHash)) {//rewritten rather than appended to, start over
+        reset();
+        this->rewritten = true;
+    }
+    this->fileId = id;
+    //stop after the last newline, a row still being written is picked up by the next refresh
+    const char* begin = casesFile.begin() + this->consumed;
+    const char* end = casesFile.end();
+    while(end > begin && end[-1] != '\n')
+        end--;
+    if(progress != nullptr)
+        progress->bytesTotal = static_cast<size_t>(end - begin);
+    if(this->backend == MAP) {
+        this->newRows = forEachRowReporting(begin, end, progress, [&](const CaseRow& row) {
+            this->map.insert(row.state, row.cases);
+        });
+    }
+    else {
+        this->newRows = forEachRowReporting(begin, end, progress, [&](const CaseRow& row) {
+            this->counter.add(row.state, row.cases);
+        });
+    }
+    if(progress != nullptr && progress->cancelled)//stopped between blocks, bytesDone covers exactly the blocks parsed
+        this->consumed += progress->bytesDone;
+    else
+        this->consumed += static_cast<size_t>(end - begin);
+    this->tailHash = tailHashOf(casesFile.begin(), casesFile.begin() + this->consumed);
+    this->rows += this->newRows;
+    build.stop();
+    this->refreshAllocations = allocationCount() - allocationsBefore;
+    this->refreshMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    return this->newRows;
+}
+
+AggregateResult IncrementalAggregator::result(const vector<string>& stateStrings) const {
+    AggregateResult result;
+    result.ok = this->ok;
+    result.stateCases.assign(stateStrings.size(), 0);
+    result.rows = this->rows;
+    result.loadMicros = this->refreshMicros;
+    result.stages = this->refreshStages;
+    result.allocations = this->refreshAllocations;
+    TraceScope retrieve("aggregate", &result.stages);
+    auto start = chrono::high_resolution_clock::now();
+    for(size_t i = 0; i < stateStrings.size(); i++) {
+        if(this->backend == MAP) {
+            long long cases = this->map.getCases(stateStrings[i]);
+            result.stateCases[i] = cases < 0 ? 0 : cases;
+        }
+        else {
+            int index = stateIndex(stateStrings[i]);
+            result.stateCases[i] = index >= 0 ? this->counter.getCases(index) : 0;
+        }
+    }
+    retrieve.stop();
+    result.retrievalMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    result.totalCases = this->backend == MAP ? this->map.totalCases : this->counter.totalCases;
+    result.hotspots = this->backend == MAP ? hotspotsOf(this->map, stateStrings) : hotspotsOf(result.stateCases);
+    result.stats = "Incremental: " + to_string(this->newRows) + " new of " + to_string(this->rows) + " rows";
+    return result;
+}
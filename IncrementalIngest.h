@@ -0,0 +1,43 @@
+#ifndef INCREMENTALINGEST_H
+#define INCREMENTALINGEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Aggregate.h"
+#include "Map.h"
+#include "StateIndex.h"
+
+struct LoadProgress;
+
+/* Aggregation that stays alive between refreshes and only parses the rows appended to the file since the last one.
+ * A file that was replaced, shrank, or changed in the last block already read is treated as rewritten and read again
+ * from the start, so a daily regeneration of cases.csv at the same size or larger does not keep the old totals.
+ */
+class IncrementalAggregator {
+    Backend backend; // MAP keeps a Map tree, every other backend a dense per-state array
+    Map map; // Totals by state name when backend is MAP
+    StateCounter counter; // Totals by state index for every other backend
+    size_t consumed; // Bytes after the header line already ingested, always just past a newline
+    uint64_t fileId; // Device and inode of the file last read, a different one means it was replaced (0 on Windows)
+    uint64_t tailHash; // Hash of the last consumed bytes, different bytes there mean the file was rewritten in place
+    bool rewritten; // Whether the last refresh found the file rewritten and read it from the start
+    size_t rows; // Rows ingested so far
+    size_t newRows; // Rows ingested by the last refresh
+    long long refreshMicros; // Time the last refresh took
+    std::vector<StageTime> refreshStages; // Time of each stage of the last refresh
+    size_t refreshAllocations; // Calls to operator new during the last refresh
+    bool ok; // Whether the last refresh could open the file
+
+    void reset(); // Forget every row, the next refresh reads the file from the start
+public:
+    explicit IncrementalAggregator(Backend backend);
+
+    Backend getBackend() const { return backend; }
+    bool wasRewritten() const { return rewritten; } // Whether the last refresh started over, its totals may differ even with no new rows
+    size_t refresh(const std::string& path, LoadProgress* progress = nullptr); // Ingest the complete rows appended since the last refresh, returns how many there were
+    AggregateResult result(const std::vector<std::string>& stateStrings) const; // Current totals, load time is the last refresh's
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "Json.h"
+
+using namespace std;
+
+string jsonEscape(string_view text) {
+    static const char HEX[] = "0123456789abcdef";
+    string escaped;
+    escaped.reserve(text.size());
+    for(char c : text) {
+        if(c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if(c == '\n')
+            escaped += "\\n";
+        else if(c == '\t')
+            escaped += "\\t";
+        else if(static_cast<unsigned char>(c) < 0x20) {//every other control character as \u00XX
+            escaped += "\\u00";
+            escaped += HEX[c >> 4];
+            escaped += HEX[c & 0xF];
+        }
+        else
+            escaped += c;
+    }
+    return escaped;
+}
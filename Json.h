@@ -0,0 +1,9 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <string_view>
+
+std::string jsonEscape(std::string_view text); // text as the inside of a JSON string, quotes, backslashes and control characters escaped
+
+#endif
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Load generator for the query server, each connection sends its requests one after another and times every one
+
+// What one connection measured
+struct ConnectionResult {
+    vector<long long> latencies; // Nanoseconds from sending each request to reading the end of its response
+    size_t failures = 0; // Requests answered with a status other than 200, or not answered at all
+    size_t bytes = 0; // Response bytes read, headers included
+};
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [--port <n> | --socket <path>] [--connections <n>] [--requests <n>] [--warmup <n>]\n"
+         << "       [--targets <target,...>] [--output <results.json>]\n"
+         << "Sends requests to a running query server (Project3 --serve) over keep-alive connections and reports\n"
+         << "throughput and latency percentiles as JSON. Targets are requested round robin by every connection.\n"
+         << "Defaults: --port 8080 --connections 16 --requests 200000 --warmup 2000, results are written to stdout.\n"
+         << "Exits with status 1 if any request failed." << endl;
+}
+
+// Nearest-rank percentile of a sorted list of times
+static long long percentile(const vector<long long>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * sorted.size() + 0.999999);
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+// Open a blocking connection to the server, -1 on failure
+static int connectTo(const string& socketPath, int port) {
+    int fd;
+    if(!socketPath.empty()) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if(socketPath.size() >= sizeof(address.sun_path))
+            return -1;
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+            return fd;
+    }
+    else {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        if(fd >= 0 && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)) == 0
+                && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+            return fd;
+    }
+    if(fd >= 0)
+        close(fd);
+    return -1;
+}
+
+// Send one request and read its whole response, returns the status, 0 if the connection failed
+static int roundTrip(int fd, const string& request, string& buffer, size_t& bytes) {
+    for(size_t sent = 0; sent < request.size(); ) {
+        ssize_t count = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if(count <= 0)
+            return 0;
+        sent += static_cast<size_t>(count);
+    }
+    buffer.clear();
+    size_t headEnd = string::npos, length = 0;
+    char chunk[64 << 10];
+    while(headEnd == string::npos || buffer.size() < headEnd + 4 + length) {
+        ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+        if(count <= 0)
+            return 0;
+        buffer.append(chunk, static_cast<size_t>(count));
+        if(headEnd == string::npos && (headEnd = buffer.find("\r\n\r\n")) != string::npos) {
+            size_t field = buffer.find("Content-Length:");
+            if(field == string::npos || field > headEnd)
+                return 0;
+            length = stoull(buffer.substr(field + 15, headEnd - field - 15));
+        }
+    }
+    bytes += buffer.size();
+    return buffer.compare(0, 9, "HTTP/1.1 ") == 0 ? atoi(buffer.c_str() + 9) : 0;
+}
+
+int main(int argc, char* argv[]) {
+    int port = 8080;
+    string socketPath, output;
+    size_t connections = 16, requests = 200000, warmup = 2000;
+    vector<string> targets = {"/states", "/state?name=New+York", "/states?date=2020-06-01", "/dates", "/series?name=Florida"};
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if(i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        bool valid = true;
+        if(arg == "--port")
+            valid = (port = atoi(value.c_str())) > 0 && port < 65536;
+        else if(arg == "--socket")
+            socketPath = value;
+        else if(arg == "--connections")
+            valid = (connections = strtoull(value.c_str(), nullptr, 10)) > 0;
+        else if(arg == "--requests")
+            valid = (requests = strtoull(value.c_str(), nullptr, 10)) > 0;
+        else if(arg == "--warmup")
+            warmup = strtoull(value.c_str(), nullptr, 10);
+        else if(arg == "--output")
+            output = value;
+        else if(arg == "--targets") {
+            targets.clear();
+            stringstream stream(value);
+            string target;
+            while(getline(stream, target, ',')) {
+                if(target.empty() || target[0] != '/')
+                    valid = false;
+                targets.push_back(target);
+            }
+            valid = valid && !targets.empty();
+        }
+        else
+            valid = false;
+        if(!valid) {
+            cerr << "Invalid option " << arg << " " << value << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<string> messages;
+    for(const string& target : targets)
+        messages.push_back("GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    vector<ConnectionResult> results(connections);
+    atomic<size_t> ready{0};
+    atomic<bool> go{false};
+    vector<thread> clients;
+    for(size_t c = 0; c < connections; c++) {
+        clients.emplace_back([&, c]() {
+            ConnectionResult& result = results[c];
+            size_t share = requests / connections + (c < requests % connections ? 1 : 0);
+            size_t warmupShare = warmup / connections;
+            int fd = connectTo(socketPath, port);
+            string buffer;
+            size_t next = c;//connections start at different targets so every target is in flight at once
+            for(size_t i = 0; i < warmupShare && fd >= 0; i++, next++)//fills the server's cache and the socket buffers, not timed
+                roundTrip(fd, messages[next % messages.size()], buffer, result.bytes);
+            result.bytes = 0;
+            result.latencies.reserve(share);
+            ready++;
+            while(!go)
+                this_thread::yield();
+            for(size_t i = 0; i < share; i++, next++) {
+                if(fd < 0) {
+                    result.failures += share - i;
+                    break;
+                }
+                auto start = chrono::steady_clock::now();
+                int status = roundTrip(fd, messages[next % messages.size()], buffer, result.bytes);
+                result.latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+                if(status != 200)
+                    result.failures++;
+                if(status == 0) {//the connection broke, try a new one for the rest
+                    close(fd);
+                    fd = connectTo(socketPath, port);
+                }
+            }
+            if(fd >= 0)
+                close(fd);
+        });
+    }
+    while(ready < connections)
+        this_thread::yield();
+    auto start = chrono::steady_clock::now();
+    go = true;
+    for(thread& client : clients)
+        client.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<long long> latencies;
+    size_t failures = 0, bytes = 0;
+    for(const ConnectionResult& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        failures += result.failures;
+        bytes += result.bytes;
+    }
+    sort(latencies.begin(), latencies.end());
+    if(latencies.empty()) {
+        cerr << "No requests were sent, is the server running?" << endl;
+        return 1;
+    }
+    auto micros = [&](double p) { return percentile(latencies, p) / 1000.0; };
+    stringstream json;
+    json << "{\n";
+    json << "  \"connections\": " << connections << ",\n";
+    json << "  \"requests\": " << latencies.size() << ",\n";
+    json << "  \"failures\": " << failures << ",\n";
+    json << "  \"seconds\": " << seconds << ",\n";
+    json << "  \"requestsPerSecond\": " << static_cast<long long>(latencies.size() / seconds) << ",\n";
+    json << "  \"megabytesPerSecond\": " << bytes / seconds / (1024 * 1024) << ",\n";
+    json << "  \"p50Micros\": " << micros(0.5) << ",\n";
+    json << "  \"p90Micros\": " << micros(0.9) << ",\n";
+    json << "  \"p99Micros\": " << micros(0.99) << ",\n";
+    json << "  \"p999Micros\": " << micros(0.999) << ",\n";
+    json << "  \"maxMicros\": " << latencies.back() / 1000.0 << "\n";
+    json << "}\n";
+    cerr << latencies.size() << " requests in " << seconds << " s: " << static_cast<long long>(latencies.size() / seconds)
+         << " requests/s, p99 " << micros(0.99) << " us, " << failures << " failed" << endl;
+    if(output.empty())
+        cout << json.str();
+    else {
+        ofstream out(output);
+        out << json.str();
+        if(!out.good()) {
+            cerr << "Error writing " << output << endl;
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Build images/counties.bin, the county outlines read by county mode (C key), from a county GeoJSON file.
+
+Usage:
+    python3 MakeCounties.py counties.geojson [images/counties.bin]
+    python3 MakeCounties.py --sample [images/counties-sample.bin]
+
+Input: a GeoJSON FeatureCollection with one Polygon or MultiPolygon feature per county in longitude/latitude, such
+as the Census Bureau's cartographic boundary file (cb_2019_us_county_20m.zip, converted with
+"ogr2ogr -f GeoJSON counties.geojson cb_2019_us_county_20m.shp") or plotly's geojson-counties-fips.json. The five
+digit FIPS code is taken from the feature's id or its GEOID, GEO_ID, FIPS or STATE and COUNTY properties. Counties
+outside the 50 states (territories, DC) are skipped, cases.csv has no state to color them by.
+
+Projection: lon/lat are projected with an Albers equal-area conic (its own parallels for Alaska and Hawaii), then
+each state's counties are scaled onto that state's mask, the rectangle of images/stateN.png placed at
+STATE_LOCATIONS in Heatmap.cpp. The masks are hand drawn, so outlines line up with them by bounding box, not by
+pixel. Points closer than half a pixel to the previous one are dropped and only the outer ring of every polygon is
+kept, which keeps the file small and the ear clipping in Counties.cpp fast.
+
+Output format, little-endian (see CountyMap in Counties.h):
+    char magic[4] = "CTY1"; uint32 regionCount;
+    per region: uint32 fips; uint32 ringCount;
+        per ring: uint32 pointCount; float x, y for each point
+
+--sample writes a synthetic file instead: every state's mask rectangle cut into notched tiles, numbered with odd
+county codes of that state. It needs no download and exercises loading, tessellation, hit-testing and coloring,
+but the tiles are not real counties. The GUI falls back to images/counties-sample.bin when counties.bin is missing
+and keeps a "synthetic tiles" warning on screen while they are shown.
+"""
+
+import json
+import math
+import os
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+STATE_FIPS = {"Alabama": 1, "Alaska": 2, "Arizona": 4, "Arkansas": 5, "California": 6, "Colorado": 8,
+              "Connecticut": 9, "Delaware": 10, "Florida": 12, "Georgia": 13, "Hawaii": 15, "Idaho": 16,
+              "Illinois": 17, "Indiana": 18, "Iowa": 19, "Kansas": 20, "Kentucky": 21, "Louisiana": 22, "Maine": 23,
+              "Maryland": 24, "Massachusetts": 25, "Michigan": 26, "Minnesota": 27, "Mississippi": 28,
+              "Missouri": 29, "Montana": 30, "Nebraska": 31, "Nevada": 32, "New Hampshire": 33, "New Jersey": 34,
+              "New Mexico": 35, "New York": 36, "North Carolina": 37, "North Dakota": 38, "Ohio": 39,
+              "Oklahoma": 40, "Oregon": 41, "Pennsylvania": 42, "Rhode Island": 44, "South Carolina": 45,
+              "South Dakota": 46, "Tennessee": 47, "Texas": 48, "Utah": 49, "Vermont": 50, "Virginia": 51,
+              "Washington": 53, "West Virginia": 54, "Wisconsin": 55, "Wyoming": 56}
+
+# Albers parameters (first parallel, second parallel, origin latitude, central meridian)
+ALBERS_LOWER48 = (29.5, 45.5, 37.5, -96.0)
+ALBERS_ALASKA = (55.0, 65.0, 50.0, -154.0)
+ALBERS_HAWAII = (8.0, 18.0, 3.0, -157.0)
+
+
+def state_rects():
+    """Pixel rectangle (left, top, width, height) of every state's mask, by state FIPS code"""
+    with open(os.path.join(HERE, "StateIndex.h")) as f:
+        names = re.findall(r'"([A-Za-z ]+)"', f.read().split("STATE_NAMES", 1)[1].split(";", 1)[0])
+    with open(os.path.join(HERE, "Heatmap.cpp")) as f:
+        table = f.read().split("STATE_LOCATIONS", 1)[1].split(";", 1)[0]
+    locations = [(int(x), int(y)) for x, y in re.findall(r"\{(\d+),(\d+)\}", table)]
+    if len(names) != 50 or len(locations) != 50:
+        sys.exit("Could not read STATE_NAMES from StateIndex.h or STATE_LOCATIONS from Heatmap.cpp")
+    rects = {}
+    for i, name in enumerate(names):
+        with open(os.path.join(HERE, "images", "state%d.png" % i), "rb") as f:
+            width, height = struct.unpack(">II", f.read(24)[16:24])  # IHDR follows the 8 byte signature and chunk header
+        rects[STATE_FIPS[name]] = (locations[i][0], locations[i][1], width, height)
+    return rects
+
+
+def albers(lon, lat, parameters):
+    """Project a point to a plane in units of the earth's radius, y grows to the north"""
+    first, second, origin, meridian = (math.radians(v) for v in parameters)
+    n = (math.sin(first) + math.sin(second)) / 2
+    c = math.cos(first) ** 2 + 2 * n * math.sin(first)
+    rho0 = math.sqrt(c - 2 * n * math.sin(origin)) / n
+    rho = math.sqrt(c - 2 * n * math.sin(math.radians(lat))) / n
+    theta = n * (math.radians(lon) - meridian)
+    return rho * math.sin(theta), rho0 - rho * math.cos(theta)
+
+
+def fips_of(feature):
+    """Five digit FIPS code of a feature, None if it has none"""
+    properties = feature.get("properties") or {}
+    for value in (feature.get("id"), properties.get("GEOID"), properties.get("GEO_ID"), properties.get("FIPS"),
+                  properties.get("fips")):
+        if value is not None and len(str(value)) >= 5 and str(value)[-5:].isdigit():
+            return int(str(value)[-5:])
+    if properties.get("STATE") is not None and properties.get("COUNTY") is not None:
+        return int(properties["STATE"]) * 1000 + int(properties["COUNTY"])
+    return None
+
+
+def outer_rings(geometry):
+    """Outer ring of every polygon of a Polygon or MultiPolygon, holes are dropped"""
+    if geometry is None:
+        return []
+    if geometry["type"] == "Polygon":
+        return [geometry["coordinates"][0]]
+    if geometry["type"] == "MultiPolygon":
+        return [polygon[0] for polygon in geometry["coordinates"]]
+    return []
+
+
+def convert(source):
+    """Regions as (fips, [[(x, y), ...], ...]) in pixel coordinates"""
+    rects = state_rects()
+    with open(source) as f:
+        features = json.load(f)["features"]
+    projected = {}  # State FIPS code to [(county FIPS code, rings)]
+    for feature in features:
+        fips = fips_of(feature)
+        if fips is None or fips // 1000 not in rects:
+            continue
+        state = fips // 1000
+        parameters = ALBERS_ALASKA if state == 2 else ALBERS_HAWAII if state == 15 else ALBERS_LOWER48
+        rings = []
+        for ring in outer_rings(feature.get("geometry")):
+            # The Aleutians cross the antimeridian, keep Alaska on one side of it
+            rings.append([albers(lon - 360 if state == 2 and lon > 0 else lon, lat, parameters) for lon, lat in ring])
+        projected.setdefault(state, []).append((fips, rings))
+
+    regions = []
+    for state, counties in sorted(projected.items()):
+        points = [p for _, rings in counties for ring in rings for p in ring]
+        if not points:
+            continue
+        min_x, max_x = min(p[0] for p in points), max(p[0] for p in points)
+        min_y, max_y = min(p[1] for p in points), max(p[1] for p in points)
+        left, top, width, height = rects[state]
+        scale_x = width / max(max_x - min_x, 1e-12)
+        scale_y = height / max(max_y - min_y, 1e-12)
+        for fips, rings in counties:
+            pixel_rings = []
+            for ring in rings:
+                pixels = []
+                for x, y in ring:
+                    point = (left + (x - min_x) * scale_x, top + (max_y - y) * scale_y)  # pixel y grows down
+                    if not pixels or abs(point[0] - pixels[-1][0]) + abs(point[1] - pixels[-1][1]) >= 0.5:
+                        pixels.append(point)
+                if len(pixels) >= 3:
+                    pixel_rings.append(pixels)
+            if pixel_rings:
+                regions.append((fips, pixel_rings))
+    return regions
+
+
+def sample():
+    """Synthetic regions, every state's mask rectangle cut into tiles with a notch so they are not convex"""
+    regions = []
+    for state, (left, top, width, height) in sorted(state_rects().items()):
+        columns, rows = max(1, width // 60), max(1, height // 60)
+        tile_width, tile_height = width / columns, height / rows
+        for row in range(rows):
+            for column in range(columns):
+                x, y = left + column * tile_width, top + row * tile_height
+                ring = [(x, y), (x + tile_width / 2, y + tile_height / 3), (x + tile_width, y),
+                        (x + tile_width, y + tile_height), (x, y + tile_height)]
+                regions.append((state * 1000 + 2 * (row * columns + column) + 1, [ring]))
+    return regions
+
+
+def write(path, regions):
+    with open(path, "wb") as out:
+        out.write(b"CTY1" + struct.pack("<I", len(regions)))
+        for fips, rings in regions:
+            out.write(struct.pack("<II", fips, len(rings)))
+            for ring in rings:
+                out.write(struct.pack("<I", len(ring)))
+                out.write(b"".join(struct.pack("<ff", x, y) for x, y in ring))
+
+
+def main():
+    args = sys.argv[1:]
+    if not args or args[0] in ("-h", "--help") or len(args) > 2:
+        print(__doc__)
+        return 0 if args else 1
+    if args[0] == "--sample":
+        regions, output = sample(), args[1] if len(args) > 1 else os.path.join(HERE, "images", "counties-sample.bin")
+    else:
+        regions, output = convert(args[0]), args[1] if len(args) > 1 else os.path.join(HERE, "images", "counties.bin")
+    write(output, regions)
+    print("Wrote %d counties with %d points to %s" % (len(regions), sum(len(r) for _, rings in regions for r in rings),
+                                                      output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
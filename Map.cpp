@@ -0,0 +1,348 @@
+#include "Map.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+using namespace std;
+
+Map::Map() {
+    this->root = NIL;
+    this->totalCases = 0;
+}
+
+Map::Map(size_t expectedKeys, size_t expectedKeyBytes) : Map() {
+    reserve(expectedKeys, expectedKeyBytes);
+}
+
+void Map::reserve(size_t expectedKeys, size_t expectedKeyBytes) {
+    this->nodes.reserve(expectedKeys);
+    this->keys.reserve(expectedKeyBytes != 0 ? expectedKeyBytes : expectedKeys * 16); // Guess 16 bytes per key
+}
+
+void Map::clear() {
+    this->nodes.clear();
+    this->keys.clear();
+    this->root = NIL;
+    this->totalCases = 0;
+}
+
+int Map::compare(string_view state, uint64_t prefix, uint32_t node) const {
+    uint64_t nodePrefix = this->nodes[node].prefix;
+    if(prefix != nodePrefix)
+        return prefix < nodePrefix ? -1 : 1;
+    if(state.size() <= 8 && this->nodes[node].keyLength <= 8) // Both keys fit in the prefix, only the lengths can differ
+        return state.size() == this->nodes[node].keyLength ? 0 : (state.size() < this->nodes[node].keyLength ? -1 : 1);
+    return state.compare(keyOf(node));
+}
+
+uint32_t Map::find(string_view state) const {
+    uint64_t prefix = keyPrefix(state);
+    uint32_t current = this->root;
+    while(current != NIL) {
+        int order = compare(state, prefix, current);
+        if(order == 0)
+            return current;
+        current = order < 0 ? this->nodes[current].left : this->nodes[current].right;
+    }
+    return NIL;
+}
+
+bool Map::contains(string_view state, int cases) {
+    uint32_t node = find(state);
+    if(node == NIL)
+        return false;
+    this->nodes[node].cases += cases;
+    this->totalCases += cases;
+    for(uint32_t current = node; current != NIL; current = this->nodes[current].parent)
+        this->nodes[current].subtreeCases += cases;
+    raiseMax(node, cases);
+    return true;
+}
+
+void Map::pull(uint32_t node) {
+    MapNode& n = this->nodes[node];
+    n.size = 1;
+    n.subtreeCases = n.cases;
+    n.maxCases = n.cases;
+    for(uint32_t child : {n.left, n.right}) {
+        if(child == NIL)
+            continue;
+        n.size += this->nodes[child].size;
+        n.subtreeCases += this->nodes[child].subtreeCases;
+        n.maxCases = max(n.maxCases, this->nodes[child].maxCases);
+    }
+}
+
+void Map::raiseMax(uint32_t node, long long added) {
+    if(added >= 0) { // The total only grew, so maxima change only while they are below it
+        long long cases = this->nodes[node].cases;
+        for(uint32_t current = node; current != NIL && this->nodes[current].maxCases < cases; current = this->nodes[current].parent)
+            this->nodes[current].maxCases = cases;
+        return;
+    }
+    for(uint32_t current = node; current != NIL; current = this->nodes[current].parent)
+        pull(current);
+}
+
+void Map::rotateLeft(uint32_t node) {
+    uint32_t node_right = this->nodes[node].right;
+
+    this->nodes[node].right = this->nodes[node_right].left;
+
+    if(this->nodes[node].right != NIL)
+        this->nodes[this->nodes[node].right].parent = node;
+
+    uint32_t parent = this->nodes[node].parent;
+    this->nodes[node_right].parent = parent;
+
+    if(parent == NIL)
+        this->root = node_right;
+
+    else if(node == this->nodes[parent].left)
+        this->nodes[parent].left = node_right;
+
+    else
+        this->nodes[parent].right = node_right;
+
+    this->nodes[node_right].left = node;
+    this->nodes[node].parent = node_right;
+    pull(node); // node is now the child, so it is recomputed first
+    pull(node_right);
+}
+
+void Map::rotateRight(uint32_t node) {
+    uint32_t node_left = this->nodes[node].left;
+
+    this->nodes[node].left = this->nodes[node_left].right;
+
+    if(this->nodes[node].left != NIL)
+        this->nodes[this->nodes[node].left].parent = node;
+
+    uint32_t parent = this->nodes[node].parent;
+    this->nodes[node_left].parent = parent;
+
+    if(parent == NIL)
+        this->root = node_left;
+
+    else if(node == this->nodes[parent].left)
+        this->nodes[parent].left = node_left;
+
+    else
+        this->nodes[parent].right = node_left;
+
+    this->nodes[node_left].right = node;
+    this->nodes[node].parent = node_left;
+    pull(node);
+    pull(node_left);
+}
+
+void Map::balance(uint32_t node) {
+    // A red parent is never the root, so the grandparent always exists inside the loop
+    while(node != this->root && this->nodes[node].color == 1 && this->nodes[this->nodes[node].parent].color == 1) {
+        uint32_t parent = this->nodes[node].parent;
+        uint32_t grand_parent = this->nodes[parent].parent;
+
+        if(parent == this->nodes[grand_parent].left) {
+            uint32_t uncle = this->nodes[grand_parent].right;
+
+            if(uncle != NIL && this->nodes[uncle].color == 1) {
+                this->nodes[grand_parent].color = 1;
+                this->nodes[parent].color = 0;
+                this->nodes[uncle].color = 0;
+                node = grand_parent;
+            }
+            else {
+                if(node == this->nodes[parent].right) {
+                    rotateLeft(parent);
+                    node = parent;
+                    parent = this->nodes[node].parent;
+                }
+
+                rotateRight(grand_parent);
+                swap(this->nodes[parent].color, this->nodes[grand_parent].color);
+                node = parent;
+            }
+        }
+        else {
+            uint32_t uncle = this->nodes[grand_parent].left;
+
+            if(uncle != NIL && this->nodes[uncle].color == 1) {
+                this->nodes[grand_parent].color = 1;
+                this->nodes[parent].color = 0;
+                this->nodes[uncle].color = 0;
+                node = grand_parent;
+            }
+            else {
+                if(node == this->nodes[parent].left) {
+                    rotateRight(parent);
+                    node = parent;
+                    parent = this->nodes[node].parent;
+                }
+
+                rotateLeft(grand_parent);
+                swap(this->nodes[parent].color, this->nodes[grand_parent].color);
+                node = parent;
+            }
+        }
+    }
+    this->nodes[this->root].color = 0;
+}
+
+void Map::insert(string_view state, int cases) {
+    this->totalCases += cases;
+
+    // Single descent: either finds the state's node or the parent the new node hangs from
+    uint64_t prefix = keyPrefix(state);
+    uint32_t parent = NIL;
+    uint32_t current = this->root;
+    int order = 0;
+    while(current != NIL) {
+        order = compare(state, prefix, current);
+        this->nodes[current].subtreeCases += cases; // The key is in the subtree of every node on the path
+        if(order == 0) { // Will add cases to existing state node
+            this->nodes[current].cases += cases;
+            raiseMax(current, cases);
+            return;
+        }
+        parent = current;
+        current = order < 0 ? this->nodes[current].left : this->nodes[current].right;
+    }
+
+    MapNode newNode;
+    newNode.prefix = prefix;
+    newNode.key = static_cast<uint32_t>(this->keys.size());
+    newNode.keyLength = static_cast<uint32_t>(state.size());
+    newNode.left = NIL;
+    newNode.right = NIL;
+    newNode.parent = parent;
+    newNode.color = 1;
+    newNode.cases = cases;
+    newNode.size = 1;
+    newNode.subtreeCases = cases;
+    newNode.maxCases = cases;
+    this->keys.insert(this->keys.end(), state.begin(), state.end()); // Intern the key once
+    uint32_t index = static_cast<uint32_t>(this->nodes.size());
+    this->nodes.push_back(newNode);
+
+    if(parent == NIL)
+        this->root = index;
+    else if(order < 0)
+        this->nodes[parent].left = index;
+    else
+        this->nodes[parent].right = index;
+    for(uint32_t current = parent; current != NIL; current = this->nodes[current].parent) {
+        this->nodes[current].size++;
+        this->nodes[current].maxCases = max(this->nodes[current].maxCases, static_cast<long long>(cases));
+    }
+    balance(index);
+}
+
+long long Map::getCases(string_view state) const {
+    uint32_t node = find(state);
+    if(node == NIL)
+        return -1; // Invalid state
+    return this->nodes[node].cases;
+}
+
+long long Map::prefixCases(string_view key, bool inclusive) const {
+    uint64_t prefix = keyPrefix(key);
+    long long sum = 0;
+    uint32_t current = this->root;
+    while(current != NIL) {
+        int order = compare(key, prefix, current);
+        uint32_t left = this->nodes[current].left;
+        long long leftCases = left != NIL ? this->nodes[left].subtreeCases : 0;
+        if(order < 0 || (order == 0 && !inclusive)) {
+            if(order == 0) { // Everything before key is in the left subtree
+                sum += leftCases;
+                break;
+            }
+            current = left;
+        }
+        else {
+            sum += leftCases + this->nodes[current].cases;
+            if(order == 0)
+                break;
+            current = this->nodes[current].right;
+        }
+    }
+    return sum;
+}
+
+long long Map::rangeCases(string_view low, string_view high) const {
+    if(high < low)
+        return 0;
+    return prefixCases(high, true) - prefixCases(low, false);
+}
+
+size_t Map::rank(string_view key) const {
+    uint64_t prefix = keyPrefix(key);
+    size_t before = 0;
+    uint32_t current = this->root;
+    while(current != NIL) {
+        int order = compare(key, prefix, current);
+        uint32_t left = this->nodes[current].left;
+        size_t leftSize = left != NIL ? this->nodes[left].size : 0;
+        if(order <= 0) {
+            if(order == 0)
+                return before + leftSize;
+            current = left;
+        }
+        else {
+            before += leftSize + 1;
+            current = this->nodes[current].right;
+        }
+    }
+    return before;
+}
+
+string_view Map::select(size_t index) const {
+    uint32_t current = this->root;
+    while(current != NIL) {
+        uint32_t left = this->nodes[current].left;
+        size_t leftSize = left != NIL ? this->nodes[left].size : 0;
+        if(index == leftSize)
+            return keyOf(current);
+        if(index < leftSize)
+            current = left;
+        else {
+            index -= leftSize + 1;
+            current = this->nodes[current].right;
+        }
+    }
+    return string_view();
+}
+
+vector<pair<string_view, long long>> Map::topCases(size_t k, const function<bool(string_view)>& accept) const {
+    vector<pair<string_view, long long>> top;
+    top.reserve(min(k, this->nodes.size()));
+    // Entries are either a whole subtree, ranked by its largest total, or a single node ranked by its own total
+    struct Entry {
+        long long cases;
+        uint32_t node;
+        bool whole;
+        bool operator<(const Entry& other) const { return cases < other.cases; }
+    };
+    vector<Entry> storage;
+    storage.reserve(2 * k + 2); // Each pop adds at most two entries more than it removes
+    priority_queue<Entry> frontier(less<Entry>(), move(storage));
+    if(this->root != NIL)
+        frontier.push({this->nodes[this->root].maxCases, this->root, true});
+    while(top.size() < k && !frontier.empty()) {
+        Entry entry = frontier.top();
+        frontier.pop();
+        const MapNode& node = this->nodes[entry.node];
+        if(!entry.whole) {
+            if(!accept || accept(keyOf(entry.node)))
+                top.emplace_back(keyOf(entry.node), node.cases);
+            continue;
+        }
+        frontier.push({node.cases, entry.node, false});
+        if(node.left != NIL)
+            frontier.push({this->nodes[node.left].maxCases, node.left, true});
+        if(node.right != NIL)
+            frontier.push({this->nodes[node.right].maxCases, node.right, true});
+    }
+    return top;
+}
@@ -0,0 +1,99 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// MapNode implemented as red/black tree node, nodes live in one array and link to each other by index
+struct MapNode {
+    uint64_t prefix; // First 8 bytes of the key packed big-endian, so most comparisons never touch the arena
+    uint32_t key; // Offset of the key (state name) in the map's key arena
+    uint32_t keyLength; // Length of the key in bytes
+    uint32_t left; // Index of left child
+    uint32_t right; // Index of right child
+    uint32_t parent; // Index of parent
+    bool color; // 1 is red, 0 is black
+    long long cases; // Total cases for the key from cases.csv
+    uint32_t size; // Number of nodes in the subtree rooted here
+    long long subtreeCases; // Total cases of every key in the subtree rooted here
+    long long maxCases; // Largest total of any key in the subtree rooted here
+};
+
+// Pack the first 8 bytes of a key big-endian, zero padded, so integer order matches string order
+inline uint64_t keyPrefix(std::string_view key) {
+    uint64_t prefix = 0;
+    for(size_t i = 0; i < 8; i++)
+        prefix = (prefix << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+    return prefix;
+}
+
+/* Map implemented as red/black tree over a flat node array, each distinct key is stored once in a char arena.
+ * Every node also keeps the size, case total and largest total of its subtree, which makes it an order statistics
+ * tree: prefix and range sums over keys, rank, select and the top keys by cases all take O(log n) per key visited.
+ */
+class Map {
+    std::vector<MapNode> nodes; // Every node in insertion order, freed together when the map is destroyed
+    std::vector<char> keys; // Arena holding the bytes of every distinct key back to back
+    uint32_t root; // Index of root of tree
+
+    std::string_view keyOf(uint32_t node) const { return std::string_view(keys.data() + nodes[node].key, nodes[node].keyLength); }
+    int compare(std::string_view state, uint64_t prefix, uint32_t node) const; // Order state against a node's key, <0, 0 or >0
+    uint32_t find(std::string_view state) const; // Index of the node holding state, NIL if there is none
+    void rotateLeft(uint32_t node); // Perform a left rotation to balance tree, used in balance()
+    void rotateRight(uint32_t node); // Perform a right rotation to balance tree, used in balance()
+    void balance(uint32_t node); // Balance the tree, called after insertion of a new node/vertex
+    void pull(uint32_t node); // Recompute a node's subtree fields from its children, used after rotations
+    void raiseMax(uint32_t node, long long added); // Fix subtree maxima from node up to the root after adding to its cases
+public:
+    static const uint32_t NIL = 0xFFFFFFFF; // Index used for a missing child or parent
+    long long totalCases;
+
+    Map(); // Constructor, creates an empty map with total cases 0
+    explicit Map(size_t expectedKeys, size_t expectedKeyBytes = 0); // Constructor, reserves room for expectedKeys keys
+
+    void insert(std::string_view state, int cases); // Add cases to the state's node, inserting the node if the state is new
+    long long getCases(std::string_view state) const; // Return the number of cases in a given state, -1 if it is not in the map
+    bool contains(std::string_view state, int cases); // Check if map contains a state already, if it does, add cases to existing node
+    size_t size() const { return nodes.size(); } // Number of distinct keys
+    long long prefixCases(std::string_view key, bool inclusive = false) const; // Total cases of the keys ordered before key, and key itself if inclusive
+    long long rangeCases(std::string_view low, std::string_view high) const; // Total cases of the keys in [low, high]
+    size_t rank(std::string_view key) const; // Number of keys ordered before key, whether or not key is in the map
+    std::string_view select(size_t index) const; // Key with index keys ordered before it, empty if index >= size()
+    template <class F>
+    void forEach(F&& visit) const; // Call visit(key, cases) for every key in order
+    /* Up to k keys with the most cases, most first, skipping keys accept rejects. Subtrees are searched best first by
+     * their largest total, so only the nodes above the answers are visited rather than the whole tree.
+     */
+    std::vector<std::pair<std::string_view, long long>> topCases(size_t k, const std::function<bool(std::string_view)>& accept = nullptr) const;
+    void reserve(size_t expectedKeys, size_t expectedKeyBytes = 0); // Reserve node and key storage up front
+    void clear(); // Remove every key and reset total cases to 0
+};
+
+template <class F>
+void Map::forEach(F&& visit) const {
+    uint32_t current = root;
+    while(current != NIL && nodes[current].left != NIL)
+        current = nodes[current].left;
+    while(current != NIL) {
+        visit(keyOf(current), nodes[current].cases);
+        if(nodes[current].right != NIL) { // Successor is the leftmost node of the right subtree
+            current = nodes[current].right;
+            while(nodes[current].left != NIL)
+                current = nodes[current].left;
+        }
+        else { // Otherwise the first ancestor reached from its left side
+            uint32_t child = current;
+            current = nodes[current].parent;
+            while(current != NIL && nodes[current].right == child) {
+                child = current;
+                current = nodes[current].parent;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <cstdio>
+#include <cstring>
+#endif
+
+size_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+#ifdef __linux__
+    FILE* status = fopen("/proc/self/status", "r"); // VmHWM follows resetPeakResidentBytes(), ru_maxrss does not
+    if(status != nullptr) {
+        char line[256];
+        size_t kilobytes = 0;
+        while(fgets(line, sizeof(line), status) != nullptr) {
+            if(strncmp(line, "VmHWM:", 6) == 0 && sscanf(line + 6, "%zu", &kilobytes) == 1)
+                break;
+        }
+        fclose(status);
+        if(kilobytes > 0)
+            return kilobytes * 1024;
+    }
+#endif
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // Already in bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
+
+bool resetPeakResidentBytes() {
+#ifdef __linux__
+    FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+    if(clearRefs == nullptr)
+        return false;
+    bool reset = fputs("5", clearRefs) >= 0; // 5 resets VmHWM to the current resident size
+    return fclose(clearRefs) == 0 && reset;
+#else
+    return false;
+#endif
+}
+
+static std::atomic<size_t> allocations{0}; // Calls to the replaced operator new
+
+size_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+/* Replacements of the global operator new and delete that count allocations. Array and nothrow forms call these, the
+ * aligned forms are left to the library and are not counted.
+ */
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
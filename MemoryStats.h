@@ -0,0 +1,15 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <cstddef>
+
+// Return the peak resident set size of this process in bytes, 0 if the platform does not report it
+size_t peakResidentBytes();
+
+// Reset the peak resident set size to the current size, returns whether the platform supports it (Linux only)
+bool resetPeakResidentBytes();
+
+// Return how many times operator new has been called by any thread since the program started
+size_t allocationCount();
+
+#endif
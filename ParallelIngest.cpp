@@ -0,0 +1,83 @@
+#include "ParallelIngest.h"
+
+#include <cstring>
+#include <thread>
+#include "BackgroundLoad.h"
+#include "Trace.h"
+
+using namespace std;
+
+vector<pair<const char*, const char*>> splitLines(const char* begin, const char* end, unsigned count) {
+    vector<pair<const char*, const char*>> chunks;
+    if(count == 0)
+        count = 1;
+    size_t chunkSize = static_cast<size_t>(end - begin) / count + 1;
+    const char* start = begin;
+    while(start < end) {
+        const char* stop = start + chunkSize < end ? start + chunkSize : end;
+        if(stop < end) { // Move the boundary forward to the start of the next line
+            const char* newline = static_cast<const char*>(memchr(stop, '\n', end - stop));
+            stop = newline != nullptr ? newline + 1 : end;
+        }
+        chunks.emplace_back(start, stop);
+        start = stop;
+    }
+    return chunks;
+}
+
+// Aggregate one chunk into thread-local counters, states are counted by their perfect hash index and only other names are hashed
+static void aggregateChunk(const char* begin, const char* end, PartialTotals& result, LoadProgress* progress) {
+    TRACE_SCOPE("parse chunk");
+    result.rows = forEachRowReporting(begin, end, progress, [&](const CaseRow& row) {
+        result.totalCases += row.cases;
+        int index = stateIndex(row.state);
+        if(index >= 0)
+            result.stateCases[index] += row.cases;
+        else
+            result.others[row.state] += row.cases;
+    });
+}
+
+void ParallelAggregator::ingest(const CasesFile& file, unsigned threads, LoadProgress* progress) {
+    if(threads == 0)
+        threads = thread::hardware_concurrency();
+    if(threads == 0) // hardware_concurrency() may not know the core count
+        threads = 1;
+
+    auto chunks = splitLines(file.begin(), file.end(), threads);
+    this->partials.assign(chunks.size(), PartialTotals());
+
+    vector<thread> workers;
+    workers.reserve(chunks.size());
+    for(size_t i = 1; i < chunks.size(); i++)
+        workers.emplace_back(aggregateChunk, chunks[i].first, chunks[i].second, ref(this->partials[i]), progress);
+    if(!chunks.empty()) // The calling thread takes the first chunk instead of waiting idle
+        aggregateChunk(chunks[0].first, chunks[0].second, this->partials[0], progress);
+    for(auto& worker : workers)
+        worker.join();
+
+    this->totalCases = 0;
+    this->rows = 0;
+    for(const auto& partial : this->partials) {
+        this->totalCases += partial.totalCases;
+        this->rows += partial.rows;
+    }
+}
+
+vector<long long> ParallelAggregator::merge(const vector<string>& stateStrings) const {
+    TRACE_SCOPE("merge");
+    vector<long long> stateCases(stateStrings.size(), 0);
+    for(size_t j = 0; j < stateStrings.size(); j++) {
+        int index = stateIndex(stateStrings[j]);
+        for(const auto& partial : this->partials) {
+            if(index >= 0)
+                stateCases[j] += partial.stateCases[index];
+            else {
+                auto found = partial.others.find(stateStrings[j]);
+                if(found != partial.others.end())
+                    stateCases[j] += found->second;
+            }
+        }
+    }
+    return stateCases;
+}
@@ -0,0 +1,37 @@
+#ifndef PARALLELINGEST_H
+#define PARALLELINGEST_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CasesFile.h"
+#include "StateIndex.h"
+
+struct LoadProgress;
+
+// Per-state totals counted by one worker over its chunk of the file
+struct PartialTotals {
+    long long stateCases[STATE_COUNT] = {}; // Cases of each of the 50 states, indexed by stateIndex()
+    std::unordered_map<std::string_view, long long> others; // Cases of every other name (views into the file), such as territories
+    long long totalCases = 0; // Cases of every row in the chunk, including non-state rows
+    size_t rows = 0; // Number of rows in the chunk
+};
+
+// Parses cases.csv on every core, each worker aggregating its own newline-aligned chunk
+class ParallelAggregator {
+    std::vector<PartialTotals> partials; // One entry per worker, filled by ingest()
+public:
+    long long totalCases = 0;
+    size_t rows = 0;
+
+    void ingest(const CasesFile& file, unsigned threads = 0, LoadProgress* progress = nullptr); // Parse and aggregate the file, 0 threads uses every core
+    std::vector<long long> merge(const std::vector<std::string>& stateStrings) const; // Combine worker totals in stateStrings order, file must still be open
+    size_t threadCount() const { return partials.size(); } // Number of workers used by the last ingest()
+};
+
+// Split [begin, end) into at most count ranges that each end just after a newline
+std::vector<std::pair<const char*, const char*>> splitLines(const char* begin, const char* end, unsigned count);
+
+#endif
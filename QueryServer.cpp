@@ -0,0 +1,550 @@
+#include "QueryServer.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include "Json.h"
+#include "Trace.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const size_t MAX_REQUEST_BYTES = 16 << 10; // Longest request head accepted, longer ones are answered with 431
+const uint64_t WAKE_TAG = 1023; // epoll tag of the wake eventfd, listeners are tagged with their index below it
+const uint64_t FIRST_CONNECTION = 1024; // ID of the first accepted connection, IDs count up from here
+
+struct QueryServer::Connection {
+    int fd;
+    uint64_t id;
+    string in; // Bytes read and not yet parsed, may hold the start of the next request while one is in flight
+    shared_ptr<const string> out; // Response being written, nullptr when there is none
+    size_t sent = 0; // Bytes of out already written
+    bool busy = false; // Whether a request is with the workers or its response is being written
+    bool closeAfter = false; // Close once the current response is written, the client did not keep the connection alive
+    bool watchingWrites = false; // Whether the socket is registered for EPOLLOUT
+    bool peerClosed = false; // Whether the client shut down its side, buffered requests are still answered
+};
+
+const string* QueryRequest::param(string_view name) const {
+    for(const auto& entry : this->params) {
+        if(entry.first == name)
+            return &entry.second;
+    }
+    return nullptr;
+}
+
+static const char* reasonOf(int status) {
+    switch(status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default: return status >= 500 ? "Internal Server Error" : "Error";
+    }
+}
+
+string serializeResponse(const QueryResponse& response) {
+    string head = "HTTP/1.1 " + to_string(response.status) + " " + reasonOf(response.status) + "\r\nContent-Type: "
+            + response.contentType + "\r\nContent-Length: " + to_string(response.body.size()) + "\r\n\r\n";
+    string serialized;
+    serialized.reserve(head.size() + response.body.size());
+    serialized += head;
+    serialized += response.body;
+    return serialized;
+}
+
+// Error response with a one-field JSON body
+static shared_ptr<const string> errorResponse(int status, const string& message) {
+    QueryResponse response;
+    response.status = status;
+    response.body = "{\"error\": \"" + jsonEscape(message) + "\"}";
+    return make_shared<const string>(serializeResponse(response));
+}
+
+// Decode %XX escapes, and + as a space when plusIsSpace, malformed escapes are kept as they are
+static string percentDecode(string_view text, bool plusIsSpace) {
+    string decoded;
+    decoded.reserve(text.size());
+    for(size_t i = 0; i < text.size(); i++) {
+        if(text[i] == '%' && i + 2 < text.size() && isxdigit(static_cast<unsigned char>(text[i + 1]))
+                && isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+            decoded += static_cast<char>(stoi(string(text.substr(i + 1, 2)), nullptr, 16));
+            i += 2;
+        }
+        else
+            decoded += plusIsSpace && text[i] == '+' ? ' ' : text[i];
+    }
+    return decoded;
+}
+
+// Split a request target into its decoded path and query parameters
+static void parseTarget(string_view target, QueryRequest& request) {
+    request.target = string(target);
+    size_t question = target.find('?');
+    request.path = percentDecode(target.substr(0, question), false);
+    if(question == string_view::npos)
+        return;
+    string_view query = target.substr(question + 1);
+    while(!query.empty()) {
+        size_t amp = query.find('&');
+        string_view pair = query.substr(0, amp);
+        if(!pair.empty()) {
+            size_t equals = pair.find('=');
+            request.params.emplace_back(percentDecode(pair.substr(0, equals), true),
+                                        equals == string_view::npos ? string() : percentDecode(pair.substr(equals + 1), true));
+        }
+        query = amp == string_view::npos ? string_view() : query.substr(amp + 1);
+    }
+}
+
+static bool equalsIgnoringCase(string_view a, string_view b) {
+    if(a.size() != b.size())
+        return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+shared_ptr<const string> QueryServer::answer(const QueryRequest& request) {
+    uint64_t current = this->version;//read before the handler, so a response is never tagged newer than its data
+    {
+        lock_guard<mutex> lock(this->cacheMutex);
+        auto found = this->cache.find(request.target);
+        if(found != this->cache.end() && found->second.version == current) {
+            this->stats.cacheHits++;
+            return found->second.response;
+        }
+    }
+    TRACE_SCOPE("query");
+    QueryResponse response;
+    try {
+        response = this->handler(request);
+    }
+    catch(const exception&) {
+        return errorResponse(500, "query failed");
+    }
+    auto serialized = make_shared<const string>(serializeResponse(response));
+    if(response.status == 200 && response.cacheable && serialized->size() <= this->cacheLimit) {
+        lock_guard<mutex> lock(this->cacheMutex);
+        auto found = this->cache.find(request.target);
+        if(found != this->cache.end()) {
+            this->cacheBytes -= found->second.response->size();
+            this->cache.erase(found);
+        }
+        if(this->cacheBytes + serialized->size() > this->cacheLimit) {//full, start over rather than track recency per entry
+            this->cache.clear();
+            this->cacheBytes = 0;
+        }
+        this->cache.emplace(request.target, CacheEntry{current, serialized});
+        this->cacheBytes += serialized->size();
+    }
+    return serialized;
+}
+
+void QueryServer::work() {
+    while(true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(this->jobsMutex);
+            this->jobsReady.wait(lock, [&]() { return this->stopping || !this->jobs.empty(); });
+            if(this->stopping)
+                return;
+            job = move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+        shared_ptr<const string> response = answer(job.request);
+        {
+            lock_guard<mutex> lock(this->doneMutex);
+            this->done.push_back({job.connection, move(response)});
+        }
+#ifdef __linux__
+        uint64_t one = 1;
+        if(write(this->wakeFd, &one, sizeof(one)) < 0) {}//the counter only overflows after 2^64 - 1 unread wakes
+#endif
+    }
+}
+
+#ifdef __linux__
+
+QueryServer::QueryServer(QueryHandler handler, unsigned threads, size_t cacheLimit) : handler(move(handler)) {
+    this->nextConnection = FIRST_CONNECTION;
+    this->stopping = false;
+    this->cacheBytes = 0;
+    this->cacheLimit = cacheLimit;
+    this->version = 0;
+    this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(this->epollFd >= 0 && this->wakeFd >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = WAKE_TAG;
+        epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->wakeFd, &event);
+    }
+    if(threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < threads; i++)
+        this->workers.emplace_back(&QueryServer::work, this);
+}
+
+QueryServer::~QueryServer() {
+    stop();
+    {
+        lock_guard<mutex> lock(this->jobsMutex);//a worker between checking its predicate and waiting would miss the notify
+        this->stopping = true;
+    }
+    this->jobsReady.notify_all();
+    for(thread& worker : this->workers)
+        worker.join();
+    for(auto& entry : this->connections)
+        ::close(entry.second->fd);
+    for(int fd : this->listenFds)
+        ::close(fd);
+    for(const string& path : this->unixPaths)
+        unlink(path.c_str());
+    if(this->epollFd >= 0)
+        ::close(this->epollFd);
+    if(this->wakeFd >= 0)
+        ::close(this->wakeFd);
+}
+
+bool QueryServer::addListener(int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = this->listenFds.size();
+    if(this->epollFd < 0 || this->listenFds.size() >= WAKE_TAG || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0
+            || listen(fd, SOMAXCONN) < 0 || epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        this->error = string("listen: ") + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    this->listenFds.push_back(fd);
+    return true;
+}
+
+bool QueryServer::listenTcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        this->error = string("socket: ") + strerror(errno);
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);//local dashboards only, nothing is exposed to the network
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        this->error = "bind 127.0.0.1:" + to_string(port) + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    return addListener(fd);
+}
+
+bool QueryServer::listenUnix(const string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) {
+        this->error = "Socket path too long: " + path;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        this->error = string("socket: ") + strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {//left behind by a server that did not shut down, unless one still answers
+        if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            this->error = "Another server is listening on " + path;
+            ::close(fd);
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        this->error = "bind " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    this->unixPaths.push_back(path);
+    return addListener(fd);
+}
+
+uint16_t QueryServer::tcpPort() const {
+    for(int fd : this->listenFds) {
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        if(getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) == 0 && address.sin_family == AF_INET)
+            return ntohs(address.sin_port);
+    }
+    return 0;
+}
+
+void QueryServer::stop() {
+    this->stopping = true;
+    uint64_t one = 1;
+    if(this->wakeFd >= 0 && write(this->wakeFd, &one, sizeof(one)) < 0) {}//only async-signal-safe calls here
+}
+
+void QueryServer::acceptAll(int listenFd) {
+    while(true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+            return;//EAGAIN once every pending connection is taken, other errors are the client's
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));//fails harmlessly on Unix sockets
+        auto connection = make_unique<Connection>();
+        connection->fd = fd;
+        connection->id = this->nextConnection++;
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = connection->id;
+        if(epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+        this->stats.connections++;
+        this->connections.emplace(connection->id, move(connection));
+    }
+}
+
+void QueryServer::watch(Connection& connection) {
+    epoll_event event = {};
+    event.events = (connection.peerClosed ? 0u : EPOLLIN | EPOLLRDHUP) | (connection.watchingWrites ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = connection.id;
+    epoll_ctl(this->epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryServer::close(uint64_t id) {
+    auto found = this->connections.find(id);
+    if(found == this->connections.end())
+        return;
+    ::close(found->second->fd);//also removes it from the epoll set
+    this->connections.erase(found);
+}
+
+bool QueryServer::readFrom(Connection& connection) {
+    char buffer[16 << 10];
+    while(true) {
+        ssize_t count = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if(count > 0) {
+            connection.in.append(buffer, static_cast<size_t>(count));
+            if(connection.in.size() <= 4 * MAX_REQUEST_BYTES)
+                continue;
+            if(connection.busy)
+                return false;//pipelining far ahead of the responses
+            break;//a head this long gets its 431 from dispatch, anything after it waits in the socket
+        }
+        if(count == 0) {//no more requests, but the ones already sent still get their responses
+            connection.peerClosed = true;
+            watch(connection);
+            break;
+        }
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return false;//reset by the client, an unsent response is dropped when it arrives
+        if(errno != EINTR)
+            break;
+    }
+    return connection.busy || dispatch(connection);
+}
+
+bool QueryServer::dispatch(Connection& connection) {
+    size_t headEnd = connection.in.find("\r\n\r\n");
+    if(headEnd == string::npos || headEnd > MAX_REQUEST_BYTES) {
+        if(headEnd == string::npos && connection.in.size() <= MAX_REQUEST_BYTES)
+            return !connection.peerClosed;//wait for the rest of the head
+        connection.closeAfter = true;
+        return send(connection, errorResponse(431, "request too large"));
+    }
+    string_view head(connection.in.data(), headEnd);
+    size_t lineEnd = head.find("\r\n");
+    string_view line = head.substr(0, lineEnd);
+    size_t firstSpace = line.find(' '), lastSpace = line.rfind(' ');
+    bool keepAlive = false;
+    bool hasBody = false;
+    string_view method, target, protocol;
+    if(firstSpace != string_view::npos && lastSpace > firstSpace) {
+        method = line.substr(0, firstSpace);
+        target = line.substr(firstSpace + 1, lastSpace - firstSpace - 1);
+        protocol = line.substr(lastSpace + 1);
+        keepAlive = protocol == "HTTP/1.1";//1.1 keeps connections open unless told otherwise, 1.0 closes them
+    }
+    string_view headers = lineEnd == string_view::npos ? string_view() : head.substr(lineEnd + 2);
+    while(!headers.empty()) {
+        size_t end = headers.find("\r\n");
+        string_view header = headers.substr(0, end);
+        size_t colon = header.find(':');
+        if(colon != string_view::npos) {
+            string_view name = header.substr(0, colon), value = header.substr(colon + 1);
+            while(!value.empty() && value.front() == ' ')
+                value.remove_prefix(1);
+            if(equalsIgnoringCase(name, "Connection"))
+                keepAlive = equalsIgnoringCase(value, "keep-alive") || (keepAlive && !equalsIgnoringCase(value, "close"));
+            else if((equalsIgnoringCase(name, "Content-Length") && value != "0") || equalsIgnoringCase(name, "Transfer-Encoding"))
+                hasBody = true;
+        }
+        headers = end == string_view::npos ? string_view() : headers.substr(end + 2);
+    }
+    connection.busy = true;
+    connection.closeAfter = !keepAlive;
+    if(method.empty() || target.empty() || target[0] != '/' || protocol.substr(0, 5) != "HTTP/" || hasBody) {
+        connection.closeAfter = true;//the rest of the stream cannot be trusted to start at a request
+        return send(connection, errorResponse(400, "bad request"));
+    }
+    if(method != "GET") {
+        connection.in.erase(0, headEnd + 4);
+        return send(connection, errorResponse(405, "only GET is supported"));
+    }
+    Job job;
+    job.connection = connection.id;
+    parseTarget(target, job.request);
+    connection.in.erase(0, headEnd + 4);
+    {
+        lock_guard<mutex> lock(this->jobsMutex);
+        this->jobs.push_back(move(job));
+    }
+    this->jobsReady.notify_one();
+    return true;
+}
+
+bool QueryServer::send(Connection& connection, shared_ptr<const string> response) {
+    connection.out = move(response);
+    connection.sent = 0;
+    this->stats.requests++;
+    return writeTo(connection);
+}
+
+bool QueryServer::writeTo(Connection& connection) {
+    while(connection.out != nullptr && connection.sent < connection.out->size()) {
+        ssize_t count = ::send(connection.fd, connection.out->data() + connection.sent, connection.out->size() - connection.sent, MSG_NOSIGNAL);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {//the socket buffer is full, wait until it drains
+            if(!connection.watchingWrites) {
+                connection.watchingWrites = true;
+                watch(connection);
+            }
+            return true;
+        }
+        if(count < 0)
+            return false;
+        connection.sent += static_cast<size_t>(count);
+    }
+    if(connection.watchingWrites) {
+        connection.watchingWrites = false;
+        watch(connection);
+    }
+    connection.out = nullptr;
+    connection.busy = false;
+    if(connection.closeAfter)
+        return false;
+    if(connection.in.empty())
+        return !connection.peerClosed;
+    return dispatch(connection);//a pipelined request may already be buffered
+}
+
+void QueryServer::collectDone() {
+    vector<Done> finished;
+    {
+        lock_guard<mutex> lock(this->doneMutex);
+        finished.swap(this->done);
+    }
+    for(Done& entry : finished) {
+        auto found = this->connections.find(entry.connection);
+        if(found == this->connections.end())
+            continue;//the client left before its response was ready
+        if(!send(*found->second, move(entry.response)))
+            close(entry.connection);
+    }
+}
+
+void QueryServer::run() {
+    epoll_event events[128];
+    while(!this->stopping && this->epollFd >= 0) {
+        int count = epoll_wait(this->epollFd, events, 128, -1);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count < 0)
+            break;
+        for(int i = 0; i < count && !this->stopping; i++) {
+            uint64_t tag = events[i].data.u64;
+            if(tag == WAKE_TAG) {
+                uint64_t wakes;
+                if(read(this->wakeFd, &wakes, sizeof(wakes)) < 0) {}//EAGAIN when another event already drained it
+                collectDone();
+            }
+            else if(tag < this->listenFds.size())
+                acceptAll(this->listenFds[tag]);
+            else {
+                auto found = this->connections.find(tag);
+                if(found == this->connections.end())
+                    continue;
+                Connection& connection = *found->second;
+                bool open = !(events[i].events & EPOLLERR);
+                if(open && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+                    open = readFrom(connection);
+                if(open && (events[i].events & EPOLLOUT))
+                    open = writeTo(connection);
+                if(!open)
+                    close(tag);
+            }
+        }
+    }
+    {
+        lock_guard<mutex> lock(this->jobsMutex);//as in the destructor, stop() cannot lock from a signal handler
+        this->stopping = true;
+    }
+    this->jobsReady.notify_all();
+}
+
+#else
+
+QueryServer::QueryServer(QueryHandler handler, unsigned threads, size_t cacheLimit) : handler(move(handler)) {
+    (void) threads;
+    this->epollFd = -1;
+    this->wakeFd = -1;
+    this->nextConnection = FIRST_CONNECTION;
+    this->stopping = false;
+    this->cacheBytes = 0;
+    this->cacheLimit = cacheLimit;
+    this->version = 0;
+}
+
+QueryServer::~QueryServer() {}
+
+bool QueryServer::listenTcp(uint16_t port) {
+    (void) port;
+    this->error = "The query server needs Linux (epoll)";
+    return false;
+}
+
+bool QueryServer::listenUnix(const string& path) {
+    (void) path;
+    this->error = "The query server needs Linux (epoll)";
+    return false;
+}
+
+uint16_t QueryServer::tcpPort() const { return 0; }
+void QueryServer::stop() { this->stopping = true; }
+void QueryServer::run() {}
+
+#endif
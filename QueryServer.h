@@ -0,0 +1,125 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One GET request, the target split into a decoded path and decoded query parameters
+struct QueryRequest {
+    std::string target; // Path and query exactly as sent, the response cache key
+    std::string path; // Decoded path without the query, such as /states
+    std::vector<std::pair<std::string, std::string>> params; // Decoded query parameters in the order sent
+
+    const std::string* param(std::string_view name) const; // Value of the first parameter called name, nullptr if absent
+};
+
+// What a handler answers with, sent back as an HTTP/1.1 response
+struct QueryResponse {
+    int status = 200;
+    std::string contentType = "application/json";
+    std::string body;
+    bool cacheable = true; // Whether a 200 response may be served again for the same target and dataset version
+};
+
+using QueryHandler = std::function<QueryResponse(const QueryRequest&)>;
+
+// Requests served so far, readable from any thread
+struct QueryServerStats {
+    std::atomic<size_t> connections{0}; // Connections accepted
+    std::atomic<size_t> requests{0}; // Requests answered, including errors
+    std::atomic<size_t> cacheHits{0}; // Requests answered from the response cache without calling the handler
+};
+
+/* Serves GET requests over HTTP/1.1 on a localhost TCP port or a Unix socket. One thread runs an epoll loop that
+ * accepts, reads and writes every connection without blocking, complete requests are handed to a pool of worker
+ * threads that call the handler. Responses are cached by target and dataset version, so repeated queries against
+ * the same data are a lookup, and bumping the version with setVersion() makes every older entry a miss. A
+ * connection has at most one request in flight and stays open between requests unless the client asks to close it.
+ * Linux only, listen() fails elsewhere.
+ */
+class QueryServer {
+    struct Connection; // Buffers and state of one accepted socket, owned by the loop thread
+    struct Job { // Request waiting for a worker
+        uint64_t connection;
+        QueryRequest request;
+    };
+    struct Done { // Serialized response waiting for the loop to write it
+        uint64_t connection;
+        std::shared_ptr<const std::string> response;
+    };
+    struct CacheEntry {
+        uint64_t version; // Dataset version the response was built from
+        std::shared_ptr<const std::string> response; // Status line, headers and body
+    };
+
+    QueryHandler handler;
+    std::vector<int> listenFds; // Listening sockets, their epoll tag is their index
+    std::vector<std::string> unixPaths; // Socket files to remove on shutdown
+    int epollFd; // -1 if it could not be created
+    int wakeFd; // eventfd the workers and stop() write to wake the loop, -1 if it could not be created
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections; // Open connections by ID, loop thread only
+    uint64_t nextConnection; // ID of the next accepted connection, IDs are never reused so late responses are dropped safely
+    std::atomic<bool> stopping;
+
+    std::vector<std::thread> workers;
+    std::mutex jobsMutex;
+    std::condition_variable jobsReady;
+    std::deque<Job> jobs; // Requests not yet picked up by a worker
+    std::mutex doneMutex;
+    std::vector<Done> done; // Responses not yet picked up by the loop
+
+    std::mutex cacheMutex;
+    std::unordered_map<std::string, CacheEntry> cache; // Serialized responses by target
+    size_t cacheBytes; // Bytes of every cached response
+    size_t cacheLimit; // The cache is emptied when it would grow past this many bytes
+    std::atomic<uint64_t> version; // Current dataset version
+    std::string error; // Why the last listen() failed
+
+    bool addListener(int fd); // Make fd non-blocking and watch it for new connections, closes it on failure
+    void acceptAll(int listenFd); // Accept every pending connection on a listening socket
+    // The four below return false once the connection should be closed
+    bool readFrom(Connection& connection); // Read what the socket has and dispatch a request if one is complete
+    bool dispatch(Connection& connection); // Hand the next buffered request to the workers, or answer a malformed one
+    bool send(Connection& connection, std::shared_ptr<const std::string> response); // Start writing a response
+    bool writeTo(Connection& connection); // Write as much of the pending response as the socket takes
+    void watch(Connection& connection); // Register the events the connection is waiting for with epoll
+    void close(uint64_t id); // Close a connection and forget it
+    void collectDone(); // Start writing every response the workers finished
+    void work(); // Worker thread body, answers jobs until the server stops
+    std::shared_ptr<const std::string> answer(const QueryRequest& request); // Cached or freshly built response for a request
+public:
+    QueryServerStats stats;
+
+    // Constructor, 0 threads uses every core, cacheLimit bounds the bytes of cached responses
+    explicit QueryServer(QueryHandler handler, unsigned threads = 0, size_t cacheLimit = 256 << 20);
+    ~QueryServer(); // Stops the loop and the workers and closes every socket
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    bool listenTcp(uint16_t port); // Listen on 127.0.0.1:port, 0 picks a free port, returns whether it worked
+    bool listenUnix(const std::string& path); // Listen on a Unix socket at path, replacing a stale socket file
+    uint16_t tcpPort() const; // Port of the first TCP listener, 0 if there is none
+    const std::string& getError() const { return error; }
+
+    void run(); // Serve until stop() is called, on the calling thread
+    void stop(); // Make run() return, safe to call from any thread and from a signal handler
+
+    void setVersion(uint64_t version) { this->version = version; } // Responses cached for older versions stop being served
+    uint64_t getVersion() const { return version; }
+};
+
+std::string serializeResponse(const QueryResponse& response); // Status line, headers and body of an HTTP/1.1 response
+
+#endif
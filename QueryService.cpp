@@ -0,0 +1,188 @@
+#include "QueryService.h"
+
+#include <utility>
+#include "Json.h"
+#include "StateIndex.h"
+#include "Trace.h"
+
+using namespace std;
+
+QueryService::QueryService(const string& path) : path(path), stateStrings(begin(STATE_NAMES), end(STATE_NAMES)), aggregator(HASH) {
+    this->serverStats = nullptr;
+    this->unpublished = false;
+}
+
+shared_ptr<const QueryService::Dataset> QueryService::current() const {
+    lock_guard<mutex> lock(this->datasetMutex);
+    return this->dataset;
+}
+
+uint64_t QueryService::version() const {
+    shared_ptr<const Dataset> data = current();
+    return data != nullptr ? data->version : 0;
+}
+
+bool QueryService::reload() {
+    TRACE_SCOPE("reload");
+    size_t newRows = this->aggregator.refresh(this->path);//only the rows appended since the last reload
+    AggregateResult totals = this->aggregator.result(this->stateStrings);
+    if(!totals.ok)
+        return false;
+    shared_ptr<const Dataset> previous = current();
+    if(newRows == 0 && !this->aggregator.wasRewritten() && !this->unpublished && previous != nullptr)//nothing new, keep the version so cached responses stay valid
+        return true;
+    this->unpublished = true;//the aggregator has moved past these rows, a failed load below is retried on the next reload
+    auto next = make_shared<Dataset>();
+    next->totals = move(totals);
+    if(!next->series.load(this->path))//days can change anywhere in the series, so it is rebuilt on every core
+        return false;
+    next->version = previous != nullptr ? previous->version + 1 : 1;
+    this->unpublished = false;
+    lock_guard<mutex> lock(this->datasetMutex);
+    this->dataset = move(next);
+    return true;
+}
+
+static QueryResponse errorOf(int status, const string& message, bool cacheable = true) {
+    QueryResponse response;
+    response.status = status;
+    response.body = "{\"error\": \"" + jsonEscape(message) + "\"}";
+    response.cacheable = cacheable;
+    return response;
+}
+
+// Day index of date in the series, returns -1 with failure set to a 400 or 404 if it is malformed or not covered
+static int dayOf(const TimeSeries& series, const string& date, QueryResponse& failure) {
+    int day = parseDate(date);
+    if(day == NO_DATE) {
+        failure = errorOf(400, "malformed date, expected YYYY-MM-DD");
+        return -1;
+    }
+    int index = series.indexOf(day);
+    if(index < 0 || index >= series.dayCount()) {
+        failure = errorOf(404, "date outside the data, see /dates");
+        return -1;
+    }
+    return index;
+}
+
+/* Per-state values picked by the date parameters of a request, in STATE_NAMES order: the totals with no date, the
+ * cumulative cases on date, or the cases reported from from through to. selection gets the JSON fields describing
+ * the choice. Returns false with failure set if the parameters are invalid.
+ */
+static bool selectCases(const AggregateResult& totals, const TimeSeries& series, const QueryRequest& request,
+                        vector<long long>& cases, string& selection, QueryResponse& failure) {
+    const string* date = request.param("date");
+    const string* from = request.param("from");
+    const string* to = request.param("to");
+    if(date != nullptr) {
+        int index = dayOf(series, *date, failure);
+        if(index < 0)
+            return false;
+        const long long* day = series.casesOn(index);
+        cases.assign(day, day + STATE_COUNT);
+        selection = "\"date\": \"" + series.dateOf(index) + "\"";
+    }
+    else if(from != nullptr || to != nullptr) {
+        if(from == nullptr || to == nullptr) {
+            failure = errorOf(400, "from and to must be given together");
+            return false;
+        }
+        int first = dayOf(series, *from, failure), last = first < 0 ? -1 : dayOf(series, *to, failure);
+        if(first < 0 || last < 0)
+            return false;
+        if(first > last) {
+            failure = errorOf(400, "from is after to");
+            return false;
+        }
+        cases.resize(STATE_COUNT);
+        for(int state = 0; state < STATE_COUNT; state++)
+            cases[state] = series.newCases(first, last, state);
+        selection = "\"from\": \"" + series.dateOf(first) + "\", \"to\": \"" + series.dateOf(last) + "\"";
+    }
+    else {
+        cases = totals.stateCases;
+        selection = "\"total\": true";
+    }
+    return true;
+}
+
+QueryResponse QueryService::handle(const QueryRequest& request) const {
+    shared_ptr<const Dataset> data = current();//held for the whole request, a reload cannot free it underneath
+    if(data == nullptr)
+        return errorOf(503, "no data loaded yet", false);
+    const TimeSeries& series = data->series;
+    string version = "\"version\": " + to_string(data->version);
+    QueryResponse response;
+
+    if(request.path == "/" || request.path == "/help") {
+        response.body = "{" + version + ", \"routes\": [\"/states\", \"/state?name=NAME\", \"/series?name=NAME\", \"/dates\", "
+                "\"/heatmap.png\", \"/stats\"], \"selection\": [\"date=YYYY-MM-DD\", \"from=YYYY-MM-DD&to=YYYY-MM-DD\"]}";
+    }
+    else if(request.path == "/stats") {
+        response.cacheable = false;
+        response.body = "{" + version + ", \"rows\": " + to_string(data->totals.rows) + ", \"totalCases\": "
+                + to_string(data->totals.totalCases) + ", \"days\": " + to_string(series.dayCount());
+        if(this->serverStats != nullptr) {
+            response.body += ", \"connections\": " + to_string(this->serverStats->connections.load()) + ", \"requests\": "
+                    + to_string(this->serverStats->requests.load()) + ", \"cacheHits\": " + to_string(this->serverStats->cacheHits.load());
+        }
+        response.body += "}";
+    }
+    else if(request.path == "/dates") {
+        if(series.isEmpty())
+            return errorOf(404, "no dated rows");
+        response.body = "{" + version + ", \"first\": \"" + series.dateOf(0) + "\", \"last\": \"" + series.dateOf(series.dayCount() - 1)
+                + "\", \"days\": " + to_string(series.dayCount()) + "}";
+    }
+    else if(request.path == "/series") {
+        const string* name = request.param("name");
+        int state = name != nullptr ? stateIndex(*name) : -1;
+        if(state < 0)
+            return errorOf(404, "unknown state");
+        if(series.isEmpty())
+            return errorOf(404, "no dated rows");
+        response.body = "{" + version + ", \"state\": \"" + string(STATE_NAMES[state]) + "\", \"first\": \"" + series.dateOf(0)
+                + "\", \"cumulative\": [";
+        for(int day = 0; day < series.dayCount(); day++)
+            response.body += (day > 0 ? ", " : "") + to_string(series.casesOn(day)[state]);
+        response.body += "]}";
+    }
+    else if(request.path == "/states" || request.path == "/state" || request.path == "/heatmap.png") {
+        vector<long long> cases;
+        string selection;
+        QueryResponse failure;
+        if(!selectCases(data->totals, series, request, cases, selection, failure))
+            return failure;
+        if(request.path == "/heatmap.png") {
+            const string* scaleName = request.param("scale");
+            const string* paletteName = request.param("palette");
+            int scale = scaleName != nullptr ? colorScaleFromName(*scaleName) : LINEAR_SCALE;
+            int palette = paletteName != nullptr ? paletteFromName(*paletteName) : HEAT_PALETTE;
+            if(scale < 0 || palette < 0)
+                return errorOf(400, "unknown scale or palette");
+            if(!this->encoder)
+                return errorOf(503, "heatmap rendering is unavailable", false);
+            response.contentType = "image/png";
+            if(!this->encoder(cases.data(), static_cast<ColorScale>(scale), static_cast<Palette>(palette), response.body))
+                return errorOf(500, "heatmap rendering failed", false);
+        }
+        else if(request.path == "/state") {
+            const string* name = request.param("name");
+            int state = name != nullptr ? stateIndex(*name) : -1;
+            if(state < 0)
+                return errorOf(404, "unknown state");
+            response.body = "{" + version + ", " + selection + ", \"state\": \"" + string(STATE_NAMES[state]) + "\", \"cases\": "
+                    + to_string(cases[state]) + "}";
+        }
+        else {
+            response.body = "{" + version + ", " + selection + ", \"states\": {";
+            for(int state = 0; state < STATE_COUNT; state++)
+                response.body += (state > 0 ? ", \"" : "\"") + string(STATE_NAMES[state]) + "\": " + to_string(cases[state]);
+            response.body += "}}";
+        }
+    }
+    else
+        return errorOf(404, "unknown route, see /help");
+    return response;
+}
@@ -0,0 +1,60 @@
+#ifndef QUERYSERVICE_H
+#define QUERYSERVICE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Aggregate.h"
+#include "ColorScale.h"
+#include "IncrementalIngest.h"
+#include "QueryServer.h"
+#include "TimeSeries.h"
+
+// Encode a heatmap of STATE_COUNT totals as PNG bytes into png, returns whether it worked. Supplied by the side that owns SFML
+using HeatmapEncoder = std::function<bool(const long long* stateCases, ColorScale scale, Palette palette, std::string& png)>;
+
+/* The data the query server answers from, cases.csv loaded once into per-state totals and the per-day series. A
+ * reload ingests only the rows appended since the last one into the totals, rebuilds the series and publishes both
+ * as a new immutable dataset with the next version, so requests already running keep the dataset they started with.
+ *
+ * Routes, every one answers JSON except /heatmap.png:
+ *   /states                      total of every state, like the GUI's heatmaps
+ *   /states?date=YYYY-MM-DD      cumulative cases of every state at the end of that day
+ *   /states?from=DATE&to=DATE    cases reported in that range of days
+ *   /state?name=NAME[&date...]   the same for one state
+ *   /series?name=NAME            cumulative cases of one state on every day
+ *   /dates                       first and last day of the series
+ *   /heatmap.png[?date...][&scale=NAME][&palette=NAME]  the map colored by any of the selections above
+ *   /stats                       dataset and server counters, never cached
+ */
+class QueryService {
+    struct Dataset {
+        uint64_t version; // Counts reloads, starting at 1
+        AggregateResult totals; // Totals of every row, in STATE_NAMES order
+        TimeSeries series;
+    };
+
+    std::string path; // cases.csv being served
+    std::vector<std::string> stateStrings; // STATE_NAMES as strings, the order of every per-state array
+    IncrementalAggregator aggregator; // Totals kept between reloads, only touched by reload()
+    bool unpublished; // The aggregator took in rows that no published dataset shows yet, only touched by reload()
+    mutable std::mutex datasetMutex; // Guards swapping dataset, not reading through it
+    std::shared_ptr<const Dataset> dataset; // Current data, nullptr until the first reload
+    HeatmapEncoder encoder; // Renders /heatmap.png, empty when images cannot be rendered
+    const QueryServerStats* serverStats; // Counters reported by /stats, nullptr if there is no server
+
+    std::shared_ptr<const Dataset> current() const; // The dataset to answer one request from
+public:
+    explicit QueryService(const std::string& path);
+
+    bool reload(); // Ingest appended rows and publish the next version, returns false and keeps serving the old data if the file cannot be opened
+    uint64_t version() const; // Version of the current dataset, 0 before the first reload
+    void setEncoder(HeatmapEncoder encoder) { this->encoder = std::move(encoder); } // Set before serving
+    void setServerStats(const QueryServerStats* stats) { serverStats = stats; } // Set before serving
+    QueryResponse handle(const QueryRequest& request) const; // Answer one request, safe to call from every worker at once
+};
+
+#endif
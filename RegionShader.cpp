@@ -0,0 +1,60 @@
+#include "RegionShader.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Decodes the region of the pixel from the ID texture and draws it in that region's color, edge pixels keep their coverage
+static const char* const REGION_FRAGMENT_SHADER = R"(
+uniform sampler2D ids;
+uniform sampler2D colors;
+uniform vec2 colorSize;
+uniform float visible;
+
+void main() {
+    vec4 id = texture2D(ids, gl_TexCoord[0].xy);
+    float region = floor(id.r * 255.0 + 0.5) + floor(id.g * 255.0 + 0.5) * 256.0 - 1.0;
+    if(region < 0.0 || region >= visible || id.b == 0.0)
+        discard;
+    vec2 texel = vec2(mod(region, colorSize.x) + 0.5, floor(region / colorSize.x) + 0.5) / colorSize;
+    gl_FragColor = vec4(texture2D(colors, texel).rgb, id.b);
+}
+)";
+
+void RegionShader::setRegion(sf::Image& idImage, unsigned x, unsigned y, int region, sf::Uint8 coverage) {
+    if(coverage == 0 || coverage <= idImage.getPixel(x, y).b)//where regions overlap at their edges the one covering more wins
+        return;
+    idImage.setPixel(x, y, sf::Color((region + 1) & 0xFF, (region + 1) >> 8, coverage, 255));
+}
+
+bool RegionShader::load(const sf::Image& idImage, int regionCount) {
+    this->loaded = false;
+    this->regionCount = regionCount;
+    unsigned rows = max(1u, (static_cast<unsigned>(regionCount) + COLOR_COLUMNS - 1) / COLOR_COLUMNS);
+    if(!isAvailable() || regionCount <= 0 || regionCount >= 0xFFFF
+       || !this->shader.loadFromMemory(REGION_FRAGMENT_SHADER, sf::Shader::Fragment)
+       || !this->ids.loadFromImage(idImage) || !this->colors.create(COLOR_COLUMNS, rows))
+        return false;
+    this->ids.setSmooth(false);//interpolated IDs would name the wrong region
+    this->colors.setSmooth(false);
+    this->staged.assign(COLOR_COLUMNS * rows, 0);
+    this->shader.setUniform("ids", sf::Shader::CurrentTexture);
+    this->shader.setUniform("colors", this->colors);
+    this->shader.setUniform("colorSize", sf::Glsl::Vec2(COLOR_COLUMNS, rows));
+    this->loaded = true;
+    return true;
+}
+
+void RegionShader::setColors(const uint32_t* regionColors) {
+    if(!this->loaded)
+        return;
+    copy(regionColors, regionColors + this->regionCount, this->staged.begin());
+    this->colors.update(reinterpret_cast<const sf::Uint8*>(this->staged.data()));
+}
+
+void RegionShader::draw(sf::RenderTarget& target, int visibleRegions) const {
+    if(!this->loaded)
+        return;
+    this->shader.setUniform("visible", static_cast<float>(min(visibleRegions, this->regionCount)));
+    target.draw(sf::Sprite(this->ids), &this->shader);
+}
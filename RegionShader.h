@@ -0,0 +1,32 @@
+#ifndef REGIONSHADER_H
+#define REGIONSHADER_H
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+/* Colors a map of regions on the GPU. Every pixel of an ID texture names the region it belongs to and a small color
+ * texture holds one texel per region, so a fragment shader looks up each pixel's color and recoloring the whole map
+ * is a single texture update however many regions there are.
+ */
+class RegionShader {
+    mutable sf::Shader shader; // Looks up each pixel's region, then the region's color, the visible count is set while drawing
+    sf::Texture ids; // Region index + 1 in red and green, coverage in blue, 0 outside every region
+    sf::Texture colors; // Region colors, COLOR_COLUMNS regions per row
+    std::vector<uint32_t> staged; // Region colors padded to whole rows of the color texture
+    int regionCount; // Number of regions the ID texture names
+    bool loaded; // Whether the shader compiled and both textures were created
+public:
+    static const unsigned COLOR_COLUMNS = 256; // Width of the color texture
+
+    RegionShader() : regionCount(0), loaded(false) {}
+
+    static bool isAvailable() { return sf::Shader::isAvailable(); } // Whether the GPU and driver support shaders
+    static void setRegion(sf::Image& idImage, unsigned x, unsigned y, int region, sf::Uint8 coverage); // Mark one pixel of an ID image as part of region
+    bool load(const sf::Image& idImage, int regionCount); // Compile the shader and upload the ID image, must run on the drawing thread
+    void setColors(const uint32_t* regionColors); // Upload one packed color per region
+    void draw(sf::RenderTarget& target, int visibleRegions) const; // Draw the regions with index below visibleRegions
+    bool isLoaded() const { return loaded; }
+};
+
+#endif
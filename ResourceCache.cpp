@@ -0,0 +1,101 @@
+#include "ResourceCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include "Trace.h"
+
+using namespace std;
+
+ResourceCache::ResourceCache() {
+    this->decoded = false;
+    this->decodeFailed = false;
+    this->ready = false;
+}
+
+ResourceCache::~ResourceCache() {
+    if(this->loader.joinable())
+        this->loader.join();
+}
+
+void ResourceCache::decode() {
+    TRACE_SCOPE("texture decode");
+    auto start = chrono::high_resolution_clock::now();
+    bool failed = false;
+    vector<sf::Image> states(STATE_COUNT);
+    for(int i = 0; i < STATE_COUNT; i++)
+        failed |= !states[i].loadFromFile("images/state" + to_string(i) + ".png");
+    packStates(states.data());
+    for(int i = 0; i < BASE_MAPS; i++)
+        failed |= !this->baseImages[i].loadFromFile(BASE_MAP_FILES[i]);
+    ifstream fontFile(FONT_FILE, ios::binary);
+    this->fontData.assign(istreambuf_iterator<char>(fontFile), istreambuf_iterator<char>());
+    failed |= this->fontData.empty();
+    this->decodeFailed = failed;
+    this->decodeMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    this->decoded = true;
+}
+
+void ResourceCache::packStates(const sf::Image* states) {
+    int order[STATE_COUNT];
+    for(int i = 0; i < STATE_COUNT; i++)
+        order[i] = i;
+    sort(order, order + STATE_COUNT, [&](int a, int b) { return states[a].getSize().y > states[b].getSize().y; });//tallest first keeps the shelves tight
+    unsigned x = 0, y = 0, shelfHeight = 0;
+    for(int i : order) {
+        sf::Vector2u size = states[i].getSize();
+        if(x + size.x > ATLAS_WIDTH) {//start a new shelf below the tallest mask on this one
+            y += shelfHeight + 1;
+            x = 0;
+            shelfHeight = 0;
+        }
+        this->stateRects[i] = sf::IntRect(x, y, size.x, size.y);
+        x += size.x + 1;//one transparent pixel between masks so neighbours never bleed into each other
+        shelfHeight = max(shelfHeight, size.y);
+    }
+    this->atlasImage.create(ATLAS_WIDTH, y + shelfHeight, sf::Color::Transparent);
+    for(int i = 0; i < STATE_COUNT; i++)
+        this->atlasImage.copy(states[i], this->stateRects[i].left, this->stateRects[i].top);
+}
+
+bool ResourceCache::upload() {
+    TRACE_SCOPE("texture upload");
+    auto start = chrono::high_resolution_clock::now();
+    this->atlasTexture.loadFromImage(this->atlasImage);
+    this->atlasImage = sf::Image();//the texture holds the pixels now
+    for(int i = 0; i < BASE_MAPS; i++) {
+        this->baseTextures[i].loadFromImage(this->baseImages[i]);
+        this->baseImages[i] = sf::Image();
+    }
+    this->font.loadFromMemory(this->fontData.data(), this->fontData.size());
+    this->uploadMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    this->ready = true;
+    return !this->decodeFailed;
+}
+
+void ResourceCache::preload() {
+    if(this->loader.joinable() || this->ready)
+        return;
+    this->loader = thread(&ResourceCache::decode, this);
+}
+
+bool ResourceCache::poll() {
+    if(this->ready)
+        return true;
+    if(!this->decoded)
+        return false;
+    this->loader.join();
+    upload();
+    return true;
+}
+
+bool ResourceCache::load() {
+    if(this->loader.joinable())
+        this->loader.join();
+    else if(!this->ready)
+        decode();
+    if(!this->ready)
+        upload();
+    return !this->decodeFailed;
+}
@@ -0,0 +1,57 @@
+#ifndef RESOURCECACHE_H
+#define RESOURCECACHE_H
+
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "StateIndex.h"
+
+// Map images the heatmap can be drawn over, the Stack and Map versions have their button highlighted
+enum BaseMap { BLANK_MAP, STACK_MAP, MAP_MAP, BASE_MAPS };
+
+const char* const BASE_MAP_FILES[BASE_MAPS] = {"images/BWMap.png", "images/BWMapStack.png", "images/BWMapMap.png"};
+const char* const FONT_FILE = "Cave-Story.ttf";
+const unsigned ATLAS_WIDTH = 2048; // Width of the state atlas, every GPU supports textures at least this large
+
+// Every image and the font the heatmap needs, decoded once and kept resident as textures for the life of the program
+class ResourceCache {
+    sf::Image atlasImage; // Every decoded state mask packed into one image, freed once uploaded
+    sf::Image baseImages[BASE_MAPS]; // Decoded base maps, freed once uploaded
+    std::vector<char> fontData; // Font file contents, sf::Font reads glyphs from it for as long as it is used
+    sf::IntRect stateRects[STATE_COUNT]; // Where each state's mask sits in the atlas, indexed like STATE_NAMES
+    sf::Texture atlasTexture; // Masks of all states, so they can be drawn together in one call
+    sf::Texture baseTextures[BASE_MAPS]; // Base maps, indexed by BaseMap
+    sf::Font font; // Font for labels and timers
+
+    std::thread loader; // Background thread decoding the files
+    std::atomic<bool> decoded; // Set by the loader once every file has been decoded
+    bool decodeFailed; // Whether any file failed to load, written by the loader before decoded is set
+    bool ready; // Whether the textures have been uploaded
+
+    void decode(); // Read and decode every file into memory, safe to run off the main thread
+    void packStates(const sf::Image* states); // Shelf-pack the state masks into atlasImage and fill stateRects
+    bool upload(); // Create the textures from the decoded images, must run on the thread drawing them
+public:
+    long long decodeMicros = 0; // Time spent reading and decoding files
+    long long uploadMicros = 0; // Time spent creating textures from the decoded images
+
+    ResourceCache();
+    ~ResourceCache(); // Waits for a running preload to finish
+    ResourceCache(const ResourceCache&) = delete;
+    ResourceCache& operator=(const ResourceCache&) = delete;
+
+    void preload(); // Start decoding every file on a background thread
+    bool poll(); // Upload the textures if decoding has finished, returns whether the cache is ready to draw with
+    bool load(); // Decode and upload on this thread, returns whether every file loaded
+    bool isReady() const { return ready; }
+    bool failed() const { return decodeFailed; } // Whether any file could not be loaded, valid once decoding has finished
+
+    const sf::Texture& stateAtlas() const { return atlasTexture; }
+    const sf::IntRect& stateRect(int index) const { return stateRects[index]; }
+    const sf::Texture& baseMap(BaseMap map) const { return baseTextures[map]; }
+    const sf::Font& getFont() const { return font; }
+};
+
+#endif
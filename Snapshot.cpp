@@ -0,0 +1,305 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include "StringInterner.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+string snapshotPath(const string& sourcePath) {
+    return sourcePath + ".snap";
+}
+
+bool snapshotStamp(const string& sourcePath, SnapshotStamp& stamp) {
+    error_code error;
+    stamp.size = fs::file_size(sourcePath, error);
+    if(error)
+        return false;
+    stamp.time = static_cast<int64_t>(fs::last_write_time(sourcePath, error).time_since_epoch().count());
+    return !error;
+}
+
+static void writeVarint(vector<uint8_t>& out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeSignedVarint(vector<uint8_t>& out, int64_t value) {
+    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+// Append raw bytes to the file image
+static void append(vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// Append a length-prefixed string
+static void appendString(vector<uint8_t>& out, string_view text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    append(out, &length, sizeof(length));
+    append(out, text.data(), text.size());
+}
+
+// Pad the file image so the next section starts on an 8 byte boundary
+static void align(vector<uint8_t>& out) {
+    out.resize((out.size() + 7) & ~static_cast<size_t>(7), 0);
+}
+
+bool Snapshot::write(const CasesFile& source, const SnapshotStamp& stamp, const string& path) {
+    SnapshotHeader header = {};
+    memcpy(header.magic, "CSNP", 4);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    if(!source.isOpen() || source.size() != stamp.size)//the csv changed between mapping and stamping, the rows would not match the stamp
+        return false;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+
+    struct Row {
+        uint32_t state, county;
+        int32_t day, cases, deaths;
+    };
+    vector<Row> rows;
+    rows.reserve(source.estimateRows());
+    StringInterner states, counties;
+    string countyKey;//county name and FIPS code, a county is the pair since names repeat across states
+    int firstDay = NO_DATE, lastDay = NO_DATE;
+    bool valid = true;
+    source.forEachRow([&](const CaseRow& row) {
+        int day = parseDate(row.date);
+        if(day == NO_DATE)//rows the snapshot cannot represent, keep parsing the csv instead
+            valid = false;
+        countyKey.assign(row.county);
+        countyKey += '\0';
+        countyKey += row.fips;
+        rows.push_back({states.intern(row.state), counties.intern(countyKey), day, row.cases, row.deaths});
+        firstDay = firstDay == NO_DATE ? day : min(firstDay, day);
+        lastDay = lastDay == NO_DATE ? day : max(lastDay, day);
+        header.totalCases += row.cases;
+    });
+    if(!valid)
+        return false;
+    sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        if(a.state != b.state)
+            return a.state < b.state;
+        if(a.county != b.county)
+            return a.county < b.county;
+        return a.day < b.day;
+    });
+    header.firstDay = firstDay == NO_DATE ? 0 : firstDay;
+    header.dayCount = firstDay == NO_DATE ? 0 : static_cast<uint32_t>(lastDay - firstDay + 1);
+    header.rows = rows.size();
+    header.stateCount = states.size();
+    header.countyCount = counties.size();
+
+    //encode the rows, a new run starts whenever the state or county changes
+    vector<uint32_t> stateRuns(header.stateCount + 1, 0);
+    vector<SnapshotRun> runs;
+    vector<uint8_t> stream;
+    stream.reserve(rows.size() * 4);
+    Row previous = {};
+    for(size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        if(i == 0 || row.state != previous.state || row.county != previous.county) {
+            if(i == 0 || row.state != previous.state) {
+                for(uint32_t s = i == 0 ? 0 : previous.state + 1; s <= row.state; s++)
+                    stateRuns[s] = static_cast<uint32_t>(runs.size());
+            }
+            runs.push_back({row.county, 0, stream.size()});
+            previous = {row.state, row.county, header.firstDay, 0, 0};
+        }
+        writeSignedVarint(stream, static_cast<int64_t>(row.day) - previous.day);
+        writeSignedVarint(stream, static_cast<int64_t>(row.cases) - previous.cases);
+        writeSignedVarint(stream, static_cast<int64_t>(row.deaths) - previous.deaths);
+        runs.back().rows++;
+        previous = row;
+    }
+    for(uint32_t s = rows.empty() ? 0 : previous.state + 1; s <= header.stateCount; s++)
+        stateRuns[s] = static_cast<uint32_t>(runs.size());
+    header.runCount = static_cast<uint32_t>(runs.size());
+
+    vector<uint8_t> image(sizeof(SnapshotHeader), 0);
+    header.stateDictOffset = image.size();
+    for(uint32_t s = 0; s < header.stateCount; s++)
+        appendString(image, states.name(s));
+    header.countyDictOffset = image.size();
+    for(uint32_t c = 0; c < header.countyCount; c++) {
+        const string& key = counties.name(c);
+        size_t split = key.find('\0');
+        appendString(image, string_view(key).substr(0, split));
+        appendString(image, string_view(key).substr(split + 1));
+    }
+    align(image);
+    header.stateRunsOffset = image.size();
+    append(image, stateRuns.data(), stateRuns.size() * sizeof(uint32_t));
+    align(image);
+    header.runsOffset = image.size();
+    append(image, runs.data(), runs.size() * sizeof(SnapshotRun));
+    header.streamOffset = image.size();
+    header.streamSize = stream.size();
+    append(image, stream.data(), stream.size());
+    image.resize(image.size() + 8, 0);//varint reads never run off the end of the mapping
+    memcpy(image.data(), &header, sizeof(header));
+
+    //write next to the snapshot and rename over it, so a reader never maps a half written file
+    string temporary = path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if(out == nullptr)
+        return false;
+    bool written = fwrite(image.data(), 1, image.size(), out) == image.size();
+    written = fclose(out) == 0 && written;
+    error_code error;
+    if(written)
+        fs::rename(temporary, path, error);
+    if(!written || error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+bool Snapshot::open(const string& path, const string& sourcePath) {
+    this->header = nullptr;
+    this->stateNames.clear();
+    this->countyNames.clear();
+    this->countyFips.clear();
+    SnapshotStamp stamp;
+    if(!snapshotStamp(sourcePath, stamp) || !this->file.open(path) || this->file.size() < sizeof(SnapshotHeader))
+        return false;
+    const SnapshotHeader* candidate = reinterpret_cast<const SnapshotHeader*>(this->file.begin());
+    if(memcmp(candidate->magic, "CSNP", 4) != 0 || candidate->version != SNAPSHOT_VERSION || candidate->byteOrder != SNAPSHOT_BYTE_ORDER
+       || candidate->sourceSize != stamp.size || candidate->sourceTime != stamp.time)
+        return false;
+    uint64_t size = this->file.size();//every offset is checked against size before it is added to, so nothing wraps
+    if(candidate->stateRunsOffset > size || candidate->runsOffset > size || candidate->streamOffset > size
+       || (candidate->stateCount + 1ull) * sizeof(uint32_t) > size - candidate->stateRunsOffset
+       || candidate->runCount * sizeof(SnapshotRun) > size - candidate->runsOffset
+       || candidate->streamSize + 8 > size - candidate->streamOffset//the padding after the stream
+       || candidate->stateRunsOffset % alignof(uint32_t) != 0 || candidate->runsOffset % alignof(SnapshotRun) != 0)
+        return false;
+
+    //read the dictionaries into views, checking every length against the end of the file
+    const char* base = this->file.begin();
+    uint64_t offset = candidate->stateDictOffset;
+    auto readString = [&](string_view& text) {
+        uint32_t length;
+        if(offset + sizeof(length) > size)
+            return false;
+        memcpy(&length, base + offset, sizeof(length));
+        offset += sizeof(length);
+        if(offset + length > size)
+            return false;
+        text = string_view(base + offset, length);
+        offset += length;
+        return true;
+    };
+    this->stateNames.resize(candidate->stateCount);
+    for(auto& name : this->stateNames) {
+        if(!readString(name))
+            return false;
+    }
+    offset = candidate->countyDictOffset;
+    this->countyNames.resize(candidate->countyCount);
+    this->countyFips.resize(candidate->countyCount);
+    for(uint32_t c = 0; c < candidate->countyCount; c++) {
+        if(!readString(this->countyNames[c]) || !readString(this->countyFips[c]))
+            return false;
+    }
+    this->stateRuns = reinterpret_cast<const uint32_t*>(base + candidate->stateRunsOffset);
+    this->runs = reinterpret_cast<const SnapshotRun*>(base + candidate->runsOffset);
+    this->stream = reinterpret_cast<const uint8_t*>(base + candidate->streamOffset);
+    if(!checkRuns(*candidate))
+        return false;
+    this->header = candidate;
+    return true;
+}
+
+// Read one varint at p without reading at or past end, returns false if it does not end in time or is too long
+static bool readVarintWithin(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for(int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool Snapshot::checkRuns(const SnapshotHeader& candidate) const {
+    if(this->stateRuns[0] != 0 || this->stateRuns[candidate.stateCount] != candidate.runCount)
+        return false;
+    for(uint32_t s = 0; s < candidate.stateCount; s++) {
+        if(this->stateRuns[s] > this->stateRuns[s + 1])
+            return false;
+    }
+    //runs were written back to back, so each one ends where the next starts and must decode to exactly that point
+    uint64_t rows = 0;
+    for(uint32_t r = 0; r < candidate.runCount; r++) {
+        const SnapshotRun& run = this->runs[r];
+        uint64_t runEnd = r + 1 < candidate.runCount ? this->runs[r + 1].offset : candidate.streamSize;
+        if(run.county >= candidate.countyCount || run.offset > runEnd || runEnd > candidate.streamSize)
+            return false;
+        const uint8_t* p = this->stream + run.offset;
+        const uint8_t* end = this->stream + runEnd;
+        int64_t day = 0;
+        for(uint32_t i = 0; i < run.rows; i++) {
+            uint64_t value;
+            if(!readVarintWithin(p, end, value))
+                return false;
+            day += static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            if(day < 0 || day >= candidate.dayCount || !readVarintWithin(p, end, value) || !readVarintWithin(p, end, value))
+                return false;
+        }
+        if(p != end)
+            return false;
+        rows += run.rows;
+    }
+    return rows == candidate.rows;
+}
+
+void Snapshot::sumRuns(uint32_t firstRun, uint32_t lastRun, long long* stateCases) const {
+    uint32_t state = static_cast<uint32_t>(upper_bound(this->stateRuns, this->stateRuns + this->stateNames.size() + 1, firstRun) - this->stateRuns) - 1;
+    for(uint32_t r = firstRun; r < lastRun; r++) {
+        while(this->stateRuns[state + 1] <= r)
+            state++;
+        const uint8_t* p = this->stream + this->runs[r].offset;
+        long long cases = 0, sum = 0;
+        for(uint32_t i = 0; i < this->runs[r].rows; i++) {
+            readVarint(p);//day
+            cases += readSignedVarint(p);
+            readVarint(p);//deaths
+            sum += cases;
+        }
+        stateCases[state] += sum;
+    }
+}
+
+vector<long long> Snapshot::sumStates(unsigned threads) const {
+    if(threads == 0)
+        threads = thread::hardware_concurrency();
+    if(threads == 0)
+        threads = 1;
+    uint32_t runCount = this->header->runCount;
+    threads = max(1u, min(threads, runCount));
+    vector<vector<long long>> partials(threads, vector<long long>(this->stateNames.size(), 0));
+    vector<thread> workers;
+    for(unsigned t = 1; t < threads; t++)
+        workers.emplace_back(&Snapshot::sumRuns, this, runCount * t / threads, runCount * (t + 1) / threads, partials[t].data());
+    sumRuns(0, runCount / threads, partials[0].data());
+    for(auto& worker : workers)
+        worker.join();
+    for(unsigned t = 1; t < threads; t++) {
+        for(size_t s = 0; s < this->stateNames.size(); s++)
+            partials[0][s] += partials[t][s];
+    }
+    return partials[0];
+}
@@ -0,0 +1,142 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CasesFile.h"
+#include "TimeSeries.h"
+
+/* Binary snapshot of cases.csv, written after the first parse and mapped in place on later runs.
+ *
+ * Rows are sorted by state, then county, then date, so a state's rows are one contiguous range and never need a
+ * state column. Each county's rows form a run. Within a run the day, cases and deaths of every row are stored as
+ * zigzag varint deltas from the previous row of the run, interleaved in one byte stream. Cumulative counts grow
+ * slowly from day to day, so most rows take 3 to 5 bytes. The run table holds each run's byte offset, so runs can
+ * be decoded independently and in parallel. States and counties are stored once in dictionaries.
+ *
+ * The header records the size and modification time of the source file, taken when the csv was mapped, and a
+ * snapshot is only used while both match. open() checks every table and decodes every run once before trusting them.
+ */
+struct SnapshotHeader {
+    char magic[4]; // "CSNP"
+    uint32_t version; // SNAPSHOT_VERSION
+    uint32_t byteOrder; // SNAPSHOT_BYTE_ORDER as written, a snapshot from a machine of the other endianness is rejected
+    int32_t firstDay; // Day number (see parseDate) that day deltas start from
+    uint64_t sourceSize; // Size in bytes of the csv the snapshot was made from
+    int64_t sourceTime; // Modification time of the csv, in file clock ticks
+    uint64_t rows; // Number of data rows
+    int64_t totalCases; // Cases of every row
+    uint32_t stateCount; // Entries in the state dictionary
+    uint32_t countyCount; // Entries in the county dictionary
+    uint32_t runCount; // Entries in the run table
+    uint32_t dayCount; // Days from firstDay through the latest row's day, every row's day falls within them
+    uint64_t stateDictOffset; // Byte offsets of each section from the start of the file
+    uint64_t countyDictOffset;
+    uint64_t stateRunsOffset;
+    uint64_t runsOffset;
+    uint64_t streamOffset;
+    uint64_t streamSize;
+};
+
+// One county's rows within a state
+struct SnapshotRun {
+    uint32_t county; // Index in the county dictionary
+    uint32_t rows; // Number of rows in the run
+    uint64_t offset; // Byte offset of the run's first row in the stream
+};
+
+const uint32_t SNAPSHOT_VERSION = 2;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Read one LEB128 varint at p and advance p past it
+inline uint64_t readVarint(const uint8_t*& p) {
+    uint64_t value = *p & 0x7F;
+    int shift = 7;
+    while(*p++ & 0x80) {
+        value |= static_cast<uint64_t>(*p & 0x7F) << shift;
+        shift += 7;
+    }
+    return value;
+}
+
+// Read one zigzag encoded signed varint
+inline int64_t readSignedVarint(const uint8_t*& p) {
+    uint64_t value = readVarint(p);
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Size and modification time of a csv file, recorded in its snapshot
+struct SnapshotStamp {
+    uint64_t size = 0;
+    int64_t time = 0; // In file clock ticks
+};
+
+std::string snapshotPath(const std::string& sourcePath); // Where the snapshot of a csv file is kept
+bool snapshotStamp(const std::string& sourcePath, SnapshotStamp& stamp); // Stat a csv file, returns false if it cannot be read
+
+// A snapshot mapped into memory, rows are decoded straight from the mapping
+class Snapshot {
+    MappedFile file; // Mapping of the whole snapshot
+    const SnapshotHeader* header; // Start of the mapping, nullptr until open() succeeds
+    std::vector<std::string_view> stateNames; // State dictionary, views into the mapping
+    std::vector<std::string_view> countyNames; // County names, views into the mapping
+    std::vector<std::string_view> countyFips; // FIPS code of each county, views into the mapping
+    const uint32_t* stateRuns; // First run of each state, stateCount + 1 entries
+    const SnapshotRun* runs; // Run table
+    const uint8_t* stream; // Interleaved day, cases and deaths deltas
+
+    void sumRuns(uint32_t firstRun, uint32_t lastRun, long long* stateCases) const; // Add the cases of runs [firstRun, lastRun) to their states
+    bool checkRuns(const SnapshotHeader& candidate) const; // Whether the state and run tables and the stream are consistent, decodes every row
+public:
+    Snapshot() { header = nullptr; stateRuns = nullptr; runs = nullptr; stream = nullptr; }
+
+    // Encode every row of source, stamped with the stamp taken when it was mapped. Returns whether the snapshot was
+    // written, nothing is written if the file grew or shrank after the stamp
+    static bool write(const CasesFile& source, const SnapshotStamp& stamp, const std::string& path);
+    bool open(const std::string& path, const std::string& sourcePath); // Map the snapshot, fails if it is missing, corrupt or older than the source
+    bool isOpen() const { return header != nullptr; }
+
+    size_t rows() const { return header->rows; }
+    long long totalCases() const { return header->totalCases; }
+    size_t size() const { return file.size(); } // Size of the snapshot in bytes
+    size_t stateCount() const { return stateNames.size(); }
+    std::string_view stateName(uint32_t state) const { return stateNames[state]; }
+    std::vector<long long> sumStates(unsigned threads = 1) const; // Cases of each state in dictionary order, 0 threads uses every core
+
+    template <class F>
+    size_t forEachRow(F&& onRow) const; // Decode every row and call onRow(const CaseRow&) with views into the snapshot
+};
+
+template <class F>
+size_t Snapshot::forEachRow(F&& onRow) const {
+    std::vector<std::string> dates; // Text of each date, CaseRow holds views
+    CaseRow row;
+    for(uint32_t state = 0; state < stateNames.size(); state++) {
+        row.state = stateNames[state];
+        for(uint32_t r = stateRuns[state]; r < stateRuns[state + 1]; r++) {
+            row.county = countyNames[runs[r].county];
+            row.fips = countyFips[runs[r].county];
+            const uint8_t* p = stream + runs[r].offset;
+            int64_t day = 0, cases = 0, deaths = 0;
+            for(uint32_t i = 0; i < runs[r].rows; i++) {
+                day += readSignedVarint(p);
+                cases += readSignedVarint(p);
+                deaths += readSignedVarint(p);
+                if(static_cast<size_t>(day) >= dates.size()) {
+                    for(size_t d = dates.size(); d <= static_cast<size_t>(day); d++)
+                        dates.push_back(formatDate(header->firstDay + static_cast<int>(d)));
+                }
+                row.date = dates[day];
+                row.cases = static_cast<int>(cases);
+                row.deaths = static_cast<int>(deaths);
+                onRow(row);
+            }
+        }
+    }
+    return header->rows;
+}
+
+#endif
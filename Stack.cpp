@@ -0,0 +1,52 @@
+#include "Stack.h"
+
+using namespace std;
+
+Stack::Stack() {
+    this->arr = nullptr;
+    this->count = 0;
+    this->capacity = 0;
+}
+
+Stack::Stack(size_t capacity) : Stack() {
+    reserve(capacity);
+}
+
+Stack::~Stack() {
+    while(this->count > 0)
+        pop();
+    ::operator delete(this->arr);
+}
+
+Stack::Stack(Stack&& other) noexcept : Stack() {
+    *this = move(other);
+}
+
+Stack& Stack::operator=(Stack&& other) noexcept {
+    if(this != &other) {
+        swap(this->arr, other.arr);
+        swap(this->count, other.count);
+        swap(this->capacity, other.capacity);
+        swap(this->totalCases, other.totalCases);
+    }
+    return *this;
+}
+
+void Stack::grow(size_t newCapacity) {
+    StackNode* newArr = static_cast<StackNode*>(::operator new(newCapacity * sizeof(StackNode)));
+    for(size_t i = 0; i < this->count; i++) {
+        new(&newArr[i]) StackNode(move(this->arr[i]));
+        this->arr[i].~StackNode();
+    }
+    ::operator delete(this->arr);
+    this->arr = newArr;
+    this->capacity = newCapacity;
+}
+
+void Stack::pop() {
+    if(this->count > 0) {
+        this->count--;
+        this->arr[this->count].~StackNode();
+    }
+    // Will only pop if stack is not empty
+}
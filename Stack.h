@@ -0,0 +1,57 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// One row of the data file, the state is an ID from a StringInterner instead of a copy of its name
+struct StackNode {
+    uint32_t state; // Interned ID of the state of vertex
+    int cases; // Stores number of cases in state
+
+    StackNode(uint32_t state, int cases) { this->state = state; this->cases = cases; } // Constructor, initializes state and number of cases of vertex
+};
+
+// Stack implemented as a growable array, capacity doubles whenever a push finds it full
+class Stack {
+    StackNode* arr; // Raw storage for capacity nodes, the first count of them are constructed
+    size_t count; // Number of vertices in the stack
+    size_t capacity; // Number of vertices arr has room for
+
+    void grow(size_t newCapacity); // Move every vertex into storage for newCapacity vertices
+public:
+    long long totalCases = 0;
+
+    Stack(); // Constructor, creates an empty stack without allocating
+    explicit Stack(size_t capacity); // Constructor, reserves room for capacity vertices
+    ~Stack(); // Destructor, destroys the vertices and frees the array
+    Stack(Stack&& other) noexcept;
+    Stack& operator=(Stack&& other) noexcept;
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    void reserve(size_t newCapacity) { if(newCapacity > capacity) grow(newCapacity); } // Make room for newCapacity vertices up front
+    void push(const StackNode& node) { emplace(node); } // Add vertex to top of stack
+    void push(StackNode&& node) { emplace(std::move(node)); } // Add vertex to top of stack, moving it in
+    template <class... Args>
+    StackNode& emplace(Args&&... args); // Construct a vertex in place on top of the stack
+    void pop(); // Remove top vertex from stack, does nothing if the stack is empty
+    StackNode* top() { return count > 0 ? &arr[count - 1] : nullptr; } // Return top vertex in stack, nullptr if it is empty
+    size_t size() const { return count; } // Return size of stack
+    size_t getCapacity() const { return capacity; } // Return number of vertices the stack can hold before growing
+    bool isEmpty() const { return count == 0; } // Return whether stack is empty or not
+};
+
+template <class... Args>
+StackNode& Stack::emplace(Args&&... args) {
+    if(count == capacity)
+        grow(capacity < 16 ? 16 : capacity * 2);
+    StackNode* node = new(&arr[count]) StackNode(std::forward<Args>(args)...);
+    count++;
+    totalCases += node->cases;
+    return *node;
+}
+
+#endif
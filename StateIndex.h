@@ -0,0 +1,95 @@
+#ifndef STATEINDEX_H
+#define STATEINDEX_H
+
+#include <cstdint>
+#include <string_view>
+
+const int STATE_COUNT = 50;
+
+// Names of the 50 states, the index of each name is its dense state index (and its images/stateN.png)
+constexpr std::string_view STATE_NAMES[STATE_COUNT] = {"Alabama","Alaska","Arizona","Arkansas","California","Colorado","Connecticut"
+    ,"Delaware","Florida","Georgia","Hawaii","Idaho","Illinois","Indiana","Iowa","Kansas","Kentucky","Louisiana"
+    ,"Maine","Maryland","Massachusetts","Michigan","Minnesota","Mississippi","Missouri","Montana","Nebraska"
+    ,"Nevada","New Hampshire","New Jersey","New Mexico","New York","North Carolina","North Dakota","Ohio"
+    ,"Oklahoma","Oregon","Pennsylvania","Rhode Island","South Carolina","South Dakota","Tennessee","Texas"
+    ,"Utah","Vermont","Virginia","Washington","West Virginia","Wisconsin","Wyoming"};
+
+// Perfect hash from state name to dense index, the seed and slot table are searched for at compile time
+namespace stateindex_detail {
+    const int TABLE_SIZE = 256; // Slots in the hash table, a power of two
+    const uint8_t EMPTY = 0xFF; // Marks a slot no state hashes to
+
+    constexpr uint32_t hash(std::string_view name, uint32_t seed) { // FNV-1a with a seeded basis
+        uint32_t h = 2166136261u ^ seed;
+        for(char c : name)
+            h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+        return h ^ (h >> 15);
+    }
+
+    constexpr bool isPerfect(uint32_t seed) { // Whether seed maps every state to its own slot
+        bool used[TABLE_SIZE] = {};
+        for(int i = 0; i < STATE_COUNT; i++) {
+            uint32_t slot = hash(STATE_NAMES[i], seed) & (TABLE_SIZE - 1);
+            if(used[slot])
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t findSeed() { // First seed giving a collision free table
+        uint32_t seed = 0;
+        while(!isPerfect(seed))
+            seed++;
+        return seed;
+    }
+
+    struct Table {
+        uint8_t slots[TABLE_SIZE];
+    };
+
+    constexpr Table buildTable(uint32_t seed) {
+        Table table = {};
+        for(int i = 0; i < TABLE_SIZE; i++)
+            table.slots[i] = EMPTY;
+        for(int i = 0; i < STATE_COUNT; i++)
+            table.slots[hash(STATE_NAMES[i], seed) & (TABLE_SIZE - 1)] = static_cast<uint8_t>(i);
+        return table;
+    }
+
+    constexpr uint32_t SEED = findSeed();
+    constexpr Table TABLE = buildTable(SEED);
+}
+
+// Return the dense index 0-49 of a state name, or -1 for territories and anything else
+inline int stateIndex(std::string_view name) {
+    using namespace stateindex_detail;
+    uint8_t slot = TABLE.slots[hash(name, SEED) & (TABLE_SIZE - 1)];
+    if(slot == EMPTY || STATE_NAMES[slot] != name) // Names that are not states can land on a used slot
+        return -1;
+    return slot;
+}
+
+// Aggregation backend that counts cases straight into a dense per-state array
+class StateCounter {
+    long long cases[STATE_COUNT]; // Total cases of each state, indexed by stateIndex()
+public:
+    long long totalCases;
+
+    StateCounter() { clear(); }
+
+    void clear() { // Reset every state and the total to 0
+        for(int i = 0; i < STATE_COUNT; i++)
+            cases[i] = 0;
+        totalCases = 0;
+    }
+    void add(std::string_view state, long long cases) { // Add a row's cases to its state, rows of non-states only count toward the total
+        int index = stateIndex(state);
+        if(index >= 0)
+            this->cases[index] += cases;
+        totalCases += cases;
+    }
+    long long getCases(int index) const { return cases[index]; } // Return the number of cases in the state with this index
+};
+
+#endif
@@ -0,0 +1,18 @@
+#include "StringInterner.h"
+
+using namespace std;
+
+uint32_t StringInterner::intern(string_view name) {
+    if(this->lastId < this->names.size() && this->names[this->lastId] == name)
+        return this->lastId;
+    auto found = this->ids.find(name);
+    if(found != this->ids.end()) {
+        this->lastId = found->second;
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(this->names.size());
+    this->names.emplace_back(name);
+    this->ids.emplace(this->names.back(), id);
+    this->lastId = id;
+    return id;
+}
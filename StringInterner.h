@@ -0,0 +1,23 @@
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Assigns each distinct string a small dense ID, every string is copied once and then referred to by ID
+class StringInterner {
+    std::deque<std::string> names; // Interned strings indexed by ID, a deque so views into them stay valid
+    std::unordered_map<std::string_view, uint32_t> ids; // Lookup from string to ID, keys view into names
+    uint32_t lastId; // ID returned by the last intern() call, rows usually repeat the previous state
+public:
+    StringInterner() { lastId = 0; }
+
+    uint32_t intern(std::string_view name); // Return the ID of name, assigning the next ID if it is new
+    const std::string& name(uint32_t id) const { return names[id]; } // Return the string with this ID
+    uint32_t size() const { return static_cast<uint32_t>(names.size()); } // Number of distinct strings
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "TimeSeries.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include "BackgroundLoad.h"
+#include "ParallelIngest.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Day number of a proleptic Gregorian date, counted from 1970-01-01
+static int daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int parseDate(string_view date) {
+    if(date.size() != 10 || date[4] != '-' || date[7] != '-')
+        return NO_DATE;
+    for(int i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+        if(date[i] < '0' || date[i] > '9')
+            return NO_DATE;
+    }
+    static const int MONTH_DAYS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int year = parseInt(date.substr(0, 4));
+    int month = parseInt(date.substr(5, 2));
+    int day = parseInt(date.substr(8, 2));
+    if(month < 1 || month > 12 || day < 1)
+        return NO_DATE;
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    if(day > MONTH_DAYS[month - 1] + (month == 2 && leap ? 1 : 0))//such as 2020-02-31
+        return NO_DATE;
+    return daysFromCivil(year, month, day);
+}
+
+string formatDate(int day) {
+    day += 719468;
+    int era = (day >= 0 ? day : day - 146096) / 146097;
+    int dayOfEra = day - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shiftedMonth = (5 * dayOfYear + 2) / 153;
+    int month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    int year = yearOfEra + era * 400 + (month <= 2);
+    char text[32];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+    return text;
+}
+
+// Reports of one county within a worker's chunk
+struct CountyReports {
+    int firstDay; // Day of the county's first row in the chunk
+    int lastCases; // Cumulative cases of the county's latest row in the chunk
+    int state; // stateIndex() of the county's state, -1 for territories
+};
+
+/* Changes of every state on every day of one worker's chunk, day-major with STATE_COUNT columns per day. Each row
+ * adds how much its county's cumulative count grew since the county's previous row, so a prefix sum over the days
+ * gives each county's latest count even on days it did not report. The first row of a county in the chunk adds its
+ * whole count, build() subtracts what earlier chunks already counted for it.
+ */
+struct PartialSeries {
+    int firstDay = NO_DATE; // Day number of the first stored day, NO_DATE until a dated row is read
+    vector<long long> cases; // Change of each (day, state)
+    vector<long long> totals; // Change of every row of each day, including non-state rows
+    unordered_map<string_view, CountyReports> counties; // Reports by "county,state", views into the file
+    size_t rows = 0; // Number of rows in the chunk
+
+    size_t slot(int day) { // Make room for day and return its index, the file is sorted by date so this rarely grows
+        if(firstDay == NO_DATE)
+            firstDay = day;
+        if(day < firstDay) {
+            size_t shift = firstDay - day;
+            cases.insert(cases.begin(), shift * STATE_COUNT, 0);
+            totals.insert(totals.begin(), shift, 0);
+            firstDay = day;
+        }
+        size_t index = day - firstDay;
+        if(index >= totals.size()) {
+            totals.resize(index + 1, 0);
+            cases.resize((index + 1) * STATE_COUNT, 0);
+        }
+        return index;
+    }
+};
+
+// Add one chunk's rows to per-day columns, consecutive rows usually share a date so its slot is reused
+static void seriesChunk(const char* begin, const char* end, PartialSeries& result, LoadProgress* progress) {
+    TRACE_SCOPE("series chunk");
+    const int firstAllowed = daysFromCivil(FIRST_SERIES_YEAR, 1, 1), lastAllowed = daysFromCivil(LAST_SERIES_YEAR, 12, 31);
+    string_view lastDate;
+    size_t index = 0;
+    int day = NO_DATE;
+    result.rows = forEachRowReporting(begin, end, progress, [&](const CaseRow& row) {
+        if(row.date != lastDate || lastDate.empty()) {
+            int parsed = parseDate(row.date);
+            if(parsed == NO_DATE || parsed < firstAllowed || parsed > lastAllowed) {
+                lastDate = string_view();//the next row parses its date again, day still belongs to the last accepted one
+                return;
+            }
+            day = parsed;
+            index = result.slot(day);
+            lastDate = row.date;
+        }
+        string_view county(row.county.data(), row.state.data() + row.state.size() - row.county.data());//the two fields are adjacent
+        auto found = result.counties.find(county);
+        long long change = row.cases;
+        if(found == result.counties.end())
+            found = result.counties.emplace(county, CountyReports{day, row.cases, stateIndex(row.state)}).first;
+        else {
+            change -= found->second.lastCases;
+            found->second.lastCases = row.cases;
+        }
+        result.totals[index] += change;
+        if(found->second.state >= 0)
+            result.cases[index * STATE_COUNT + found->second.state] += change;
+    });
+}
+
+void TimeSeries::build(const CasesFile& file, unsigned threads, LoadProgress* progress) {
+    TRACE_SCOPE("series build");
+    if(threads == 0)
+        threads = thread::hardware_concurrency();
+    if(threads == 0)
+        threads = 1;
+
+    auto chunks = splitLines(file.begin(), file.end(), threads);
+    vector<PartialSeries> partials(chunks.size());
+    vector<thread> workers;
+    workers.reserve(chunks.size());
+    for(size_t i = 1; i < chunks.size(); i++)
+        workers.emplace_back(seriesChunk, chunks[i].first, chunks[i].second, ref(partials[i]), progress);
+    if(!chunks.empty())
+        seriesChunk(chunks[0].first, chunks[0].second, partials[0], progress);
+    for(auto& worker : workers)
+        worker.join();
+
+    int first = NO_DATE, last = NO_DATE;
+    this->rows = 0;
+    for(const auto& partial : partials) {
+        this->rows += partial.rows;
+        if(partial.firstDay == NO_DATE)
+            continue;
+        int partialLast = partial.firstDay + static_cast<int>(partial.totals.size()) - 1;
+        first = first == NO_DATE ? partial.firstDay : min(first, partial.firstDay);
+        last = last == NO_DATE ? partialLast : max(last, partialLast);
+    }
+    this->firstDay = first == NO_DATE ? 0 : first;
+    this->days = first == NO_DATE ? 0 : last - first + 1;
+    this->cumulative.assign(static_cast<size_t>(this->days) * STATE_COUNT, 0);
+    this->totals.assign(this->days, 0);
+    unordered_map<string_view, int> latest;//each county's count at the end of the chunks merged so far
+    for(const auto& partial : partials) {//chunks are merged in file order, a date split across two chunks is summed from both
+        if(partial.firstDay == NO_DATE)
+            continue;
+        size_t offset = partial.firstDay - this->firstDay;
+        for(size_t d = 0; d < partial.totals.size(); d++) {
+            this->totals[offset + d] += partial.totals[d];
+            for(int s = 0; s < STATE_COUNT; s++)
+                this->cumulative[(offset + d) * STATE_COUNT + s] += partial.cases[d * STATE_COUNT + s];
+        }
+        for(const auto& county : partial.counties) {//the chunk counted each county's first row in full, take off what came before it
+            if(county.second.firstDay < this->firstDay || county.second.firstDay >= this->firstDay + this->days)
+                continue;//never happens for rows seriesChunk accepted, checked so a bad day cannot index outside the series
+            int& previous = latest[county.first];
+            size_t day = county.second.firstDay - this->firstDay;
+            this->totals[day] -= previous;
+            if(county.second.state >= 0)
+                this->cumulative[day * STATE_COUNT + county.second.state] -= previous;
+            previous = county.second.lastCases;
+        }
+    }
+    for(int d = 1; d < this->days; d++) {//changes to cumulative counts
+        for(int s = 0; s < STATE_COUNT; s++)
+            this->cumulative[static_cast<size_t>(d) * STATE_COUNT + s] += this->cumulative[static_cast<size_t>(d - 1) * STATE_COUNT + s];
+        this->totals[d] += this->totals[d - 1];
+    }
+}
+
+bool TimeSeries::load(const string& path, unsigned threads, LoadProgress* progress) {
+    auto start = chrono::high_resolution_clock::now();
+    CasesFile casesFile(path);
+    if(!casesFile.isOpen())
+        return false;
+    if(progress != nullptr)
+        progress->bytesTotal = static_cast<size_t>(casesFile.end() - casesFile.begin());
+    build(casesFile, threads, progress);
+    this->loadMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
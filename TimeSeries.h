@@ -0,0 +1,51 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CasesFile.h"
+#include "StateIndex.h"
+
+struct LoadProgress;
+
+const int NO_DATE = INT_MIN; // Day number returned for a malformed date
+const int FIRST_SERIES_YEAR = 2000, LAST_SERIES_YEAR = 2099; // Rows dated outside these years are skipped, so one bad date cannot size the series
+
+int parseDate(std::string_view date); // Day number of a YYYY-MM-DD date counted from 1970-01-01, NO_DATE if malformed or not a real day
+std::string formatDate(int day); // YYYY-MM-DD form of a day number
+
+// Per-day cases of every state, built once from cases.csv. The file's cases are cumulative, so the stored values
+// are already prefix sums of the daily new cases and any date or date range is answered in O(1) per state. A county
+// missing from a day keeps its last reported count, the rows of each county are expected in date order as in the file
+class TimeSeries {
+    int firstDay; // Day number of day index 0
+    int days; // Number of days from the first to the last date in the file
+    std::vector<long long> cumulative; // Cumulative cases of each state at the end of each day, day-major
+    std::vector<long long> totals; // Cumulative cases of every row at the end of each day, including territories
+public:
+    size_t rows = 0; // Number of data rows read
+    long long loadMicros = 0; // Time to parse the file and build the series
+
+    TimeSeries() { firstDay = 0; days = 0; }
+
+    void build(const CasesFile& file, unsigned threads = 0, LoadProgress* progress = nullptr); // Parse every row on every core and build the series, 0 threads uses every core
+    bool load(const std::string& path, unsigned threads = 0, LoadProgress* progress = nullptr); // Map the file at path and build the series, returns whether it could be opened
+
+    int dayCount() const { return days; }
+    bool isEmpty() const { return days == 0; }
+    std::string dateOf(int index) const { return formatDate(firstDay + index); } // Date of a day index
+    int indexOf(int day) const { return day - firstDay; } // Day index of a day number, outside [0, dayCount()) if not covered
+    const long long* casesOn(int index) const { // STATE_COUNT cumulative totals indexed like STATE_NAMES, nullptr outside [0, dayCount())
+        return index >= 0 && index < days ? &cumulative[static_cast<size_t>(index) * STATE_COUNT] : nullptr;
+    }
+    long long totalOn(int index) const { return totals[index]; } // Cumulative cases of every row at the end of a day
+    long long newCases(int first, int last, int state) const { // Cases reported from the start of day first to the end of day last
+        return casesOn(last)[state] - (first > 0 ? casesOn(first - 1)[state] : 0);
+    }
+    long long newTotal(int first, int last) const { return totals[last] - (first > 0 ? totals[first - 1] : 0); }
+};
+
+#endif
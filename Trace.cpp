@@ -0,0 +1,78 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+using namespace std;
+
+const size_t MAX_TRACE_EVENTS = 1 << 20; // Events kept before new ones are dropped, about 32 MB
+
+namespace trace_detail {
+    atomic<bool> enabled{false};
+}
+
+// One complete ("ph": "X") event
+struct TraceEvent {
+    const char* name;
+    long long start;
+    long long duration;
+    uint32_t thread;
+};
+
+static mutex eventsLock; // Guards events, only taken while tracing is on
+static vector<TraceEvent> events; // Every recorded event, in the order the scopes ended
+static atomic<uint32_t> nextThread{1}; // Small ID handed to each thread that records an event
+
+void setTracing(bool enabled) {
+    traceClockMicros();//start the clock before the first event
+    trace_detail::enabled = enabled;
+}
+
+long long traceClockMicros() {
+    static const auto origin = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+void recordTraceEvent(const char* name, long long startMicros, long long durationMicros) {
+    thread_local uint32_t thread = nextThread++;
+    lock_guard<mutex> guard(eventsLock);
+    if(events.size() < MAX_TRACE_EVENTS)
+        events.push_back({name, startMicros, durationMicros, thread});
+}
+
+size_t traceEventCount() {
+    lock_guard<mutex> guard(eventsLock);
+    return events.size();
+}
+
+void clearTrace() {
+    lock_guard<mutex> guard(eventsLock);
+    events.clear();
+}
+
+bool writeChromeTrace(const string& path) {
+    ofstream out(path);
+    if(!out.is_open())
+        return false;
+    lock_guard<mutex> guard(eventsLock);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for(size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& e = events[i];
+        out << "  {\"name\": \"" << e.name << "\", \"cat\": \"project3\", \"ph\": \"X\", \"ts\": " << e.start
+            << ", \"dur\": " << e.duration << ", \"pid\": 1, \"tid\": " << e.thread << "}" << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return out.good();
+}
+
+void TraceScope::stop() {
+    if(this->start < 0)
+        return;
+    long long duration = traceClockMicros() - this->start;
+    if(this->stages != nullptr)
+        this->stages->push_back({this->name, duration});
+    if(tracingEnabled())
+        recordTraceEvent(this->name, this->start, duration);
+    this->start = -1;
+}
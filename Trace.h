@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Time one stage of a run took, kept with the run's results so the GUI can show where the time went
+struct StageTime {
+    const char* name; // Static string naming the stage
+    long long micros;
+};
+
+namespace trace_detail {
+    extern std::atomic<bool> enabled; // Whether scopes record trace events, read on every scope so it is kept lock-free
+}
+
+inline bool tracingEnabled() { return trace_detail::enabled.load(std::memory_order_relaxed); }
+void setTracing(bool enabled); // Start or stop recording trace events, events already recorded are kept
+long long traceClockMicros(); // Microseconds since the first call, the clock every trace event is stamped with
+void recordTraceEvent(const char* name, long long startMicros, long long durationMicros); // Add one complete event on this thread
+size_t traceEventCount(); // Number of events recorded and not yet cleared
+void clearTrace(); // Drop every recorded event
+bool writeChromeTrace(const std::string& path); // Write every recorded event as Chrome trace-event JSON, returns whether it was written
+
+/* Times the scope it lives in. With tracing off and no stages list this is one relaxed load and a branch, so scopes
+ * can stay in hot paths. With a stages list the time is always appended to it, with tracing on it is also recorded
+ * as a trace event on the current thread.
+ */
+class TraceScope {
+    const char* name; // Static string naming the stage
+    std::vector<StageTime>* stages; // Where the time is appended, nullptr to only trace
+    long long start; // Start time, -1 when nothing is being timed
+public:
+    explicit TraceScope(const char* name, std::vector<StageTime>* stages = nullptr)
+        : name(name), stages(stages), start(stages != nullptr || tracingEnabled() ? traceClockMicros() : -1) {}
+    ~TraceScope() { stop(); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void stop(); // End the stage before the scope does, later calls do nothing
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name) // Trace the rest of the enclosing scope
+
+#endif
@@ -2,478 +2,537 @@
 #include <vector>
 #include <iostream>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <cstdlib>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include "Aggregate.h"
+#include "BackgroundLoad.h"
+#include "Cli.h"
+#include "Counties.h"
+#include "FileWatcher.h"
+#include "Heatmap.h"
+#include "IncrementalIngest.h"
+#include "MemoryStats.h"
+#include "ResourceCache.h"
+#include "StateIndex.h"
+#include "TimeSeries.h"
+#include "Trace.h"
 
 using namespace std;
 
-// MapNode implemented as red/black tree node
-struct MapNode {
-    string state; // Name of state
-    int cases; // Total cases in state from cases.csv
-    bool color; // 1 is red, 0 is black
-    MapNode* left; // Pointer to left child
-    MapNode* right; // Pointer to right child
-    MapNode* parent; // Pointer to parent
-public:
-    MapNode(string state, int cases); // Constructor, initializes node with data, pointers to nullptr, and color to red
+// Backend buttons along the bottom of the map, Stack and Map are part of the map images
+struct Button {
+    string label; // Text shown on the button
+    int left, top, width, height; // Clickable region in window coordinates
+    bool contains(int x, int y) const { return x > left && x < left + width && y > top && y < top + height; }
 };
 
-MapNode::MapNode(string state, int cases) {
-    this->state = state;
-    this->cases = cases;
-    this->left = nullptr;
-    this->right = nullptr;
-    this->parent = nullptr;
-    this->color = 1;
+// Draw a button in the same style as the ones baked into the map images, red when it is the active backend
+void drawButton(sf::RenderTarget& target, const Button& button, const sf::Font& font, bool active) {
+    sf::RectangleShape box(sf::Vector2f(button.width - 12, button.height - 12));
+    box.setPosition(button.left + 6, button.top + 6);
+    box.setFillColor(active ? sf::Color(236,100,100) : sf::Color::White);
+    box.setOutlineColor(sf::Color::Black);
+    box.setOutlineThickness(6);
+    target.draw(box);
+    sf::Text text(button.label, font, 44);
+    text.setFillColor({0,0,0});
+    sf::FloatRect bounds = text.getLocalBounds();
+    text.setPosition(button.left + (button.width - bounds.width) / 2 - bounds.left, button.top + (button.height - bounds.height) / 2 - bounds.top);
+    target.draw(text);
 }
 
-// Map implemented as red/black tree
-class Map {
-    MapNode* root; // Root of tree
-public:
-    int totalCases;
-
-    Map() { root = nullptr; totalCases = 0; } // Constructor, initializes root to nullptr and total cases to 0
-
-    void rotateLeft(MapNode* &root, MapNode* &newNode); // Perform a left rotation to balance tree, used in balance()
-    void rotateRight(MapNode* &root, MapNode* &newNode); // Perform a right rotation to balance tree, used in balance()
-    void balance(MapNode* &root, MapNode* &newNode); // Balance the tree, called after insertion of a new node/vertex
-    void insert(string state, int cases); // Insert vertex into tree/map, sorting by state name
-    int getCases(string state); // Return the number of cases in a given state
-    bool contains(string state, int cases); // Check if tree/map contains a state already, if it does, add cases to existing node, otherwise, continue insert method
-};
-
-// Recursive helper function to check if state exists in map already
-bool containsHelper(MapNode* root, string state, int cases) {
-    if(root == nullptr)
-        return false;
-
-    if(state == root->state) {
-        root->cases += cases;
-        return true;
-    }
-    else if(state < root->state)
-        return containsHelper(root->left, state, cases);
-    else
-        return containsHelper(root->right, state, cases);
-
-}
-
-bool Map::contains(string state, int cases) {
-    bool result = containsHelper(this->root, state, cases);
-    if(result)
-        this->totalCases += cases;
-    return result;
-}
-
-// Recursive helper function to insert vertex into map
-MapNode* insertHelper(MapNode* root, MapNode* newNode) {
-    if(root == nullptr)
-        return newNode;
-
-    if(newNode->state < root->state) {
-        root->left = insertHelper(root->left, newNode);
-        root->left->parent = root;
-    }
-
-    else if(newNode->state > root->state) {
-        root->right = insertHelper(root->right, newNode);
-        root->right->parent = root;
-    }
-
-    return root;
-}
-
-void Map::rotateLeft(MapNode* &root, MapNode* &newNode) {
-    MapNode* newNode_right = newNode->right;
-
-    newNode->right = newNode_right->left;
-
-    if(newNode->right != nullptr)
-        newNode->right->parent = newNode;
-
-    newNode_right->parent = newNode->parent;
-
-    if(newNode->parent == nullptr)
-        root = newNode_right;
-
-    else if(newNode == newNode->parent->left)
-        newNode->parent->left = newNode_right;
-
-    else
-        newNode->parent->right = newNode_right;
-
-    newNode_right->left = newNode;
-    newNode->parent = newNode_right;
-}
-
-void Map::rotateRight(MapNode* &root, MapNode* &newNode) {
-    MapNode* newNode_left = newNode->left;
-
-    newNode->left = newNode_left->right;
-
-    if(newNode->left != nullptr)
-        newNode->left->parent = newNode;
-
-    newNode_left->parent = newNode->parent;
-
-    if(newNode->parent == nullptr)
-        root = newNode_left;
-
-    else if(newNode == newNode->parent->left)
-        newNode->parent->left = newNode_left;
-
-    else
-        newNode->parent->right = newNode_left;
-
-    newNode_left->right = newNode;
-    newNode->parent = newNode_left;
-}
-
-void Map::balance(MapNode* &root, MapNode* &newNode) {
-    MapNode* newNode_parent = nullptr;
-    MapNode* newNode_grand_parent = nullptr;
-
-    while((newNode != root) && (newNode->color != 0) && (newNode->parent != nullptr) && (newNode->parent->color == 1)) {
-        newNode_parent = newNode->parent;
-        newNode_grand_parent = newNode->parent->parent;
-
-        if(newNode_parent == newNode_grand_parent->left) {
-            MapNode* newNode_uncle = newNode_grand_parent->right;
-
-            if(newNode_uncle != nullptr && newNode_uncle->color == 1) {
-                newNode_grand_parent->color = 1;
-                newNode_parent->color = 0;
-                newNode_uncle->color = 0;
-                newNode = newNode_grand_parent;
-            }
-            else {
-                if(newNode == newNode_parent->right) {
-                    rotateLeft(root, newNode_parent);
-                    newNode = newNode_parent;
-                    newNode_parent = newNode->parent;
-                }
-
-                rotateRight(root, newNode_grand_parent);
-                swap(newNode_parent->color, newNode_grand_parent->color);
-                newNode = newNode_parent;
-            }
-        }
-        else {
-            MapNode* newNode_uncle = newNode_grand_parent->left;
-
-            if((newNode_uncle != nullptr) && (newNode_uncle->color == 1)) {
-                newNode_grand_parent->color = 1;
-                newNode_parent->color = 0;
-                newNode_uncle->color = 0;
-                newNode = newNode_grand_parent;
-            }
-            else {
-                if (newNode == newNode_parent->left) {
-                    rotateRight(root, newNode_parent);
-                    newNode = newNode_parent;
-                    newNode_parent = newNode->parent;
-                }
-
-                rotateLeft(root, newNode_grand_parent);
-                swap(newNode_parent->color, newNode_grand_parent->color);
-                newNode = newNode_parent;
-            }
-        }
-    }
-    root->color = 0;
-}
-
-void Map::insert(string state, int cases) {
-    if(contains(state, cases)) // Will add cases to existing state node
-        return;
-    MapNode* newNode = new MapNode(state, cases);
-    root = insertHelper(root, newNode);
-    this->totalCases += cases;
-    balance(root, newNode);
-}
-
-// Recursive helper function to return cases in a given state in the map
-int getCasesHelper(MapNode* &root, string state) {
-    if(state == root->state)
-        return root->cases;
-    else if(state < root->state)
-        return getCasesHelper(root->left, state);
-    else
-        return getCasesHelper(root->right, state);
-
-    cout << "Invalid state." << endl;
-    return -1;
-}
-
-int Map::getCases(string state) {
-    return getCasesHelper(this->root, state);
-}
-
-class StackNode {
-public:
-    string state; // Stores state of vertex
-    int cases; // Stores number of cases in state
-
-    StackNode() { this->state = ""; this->cases = -1; } // Default constructor for stack array creation with default values
-    StackNode(string state, int cases) { this->state = state; this->cases = cases; } // Constructor, initializes state and number of cases of vertex
-    void operator=(StackNode* other) { this->state = other->state; this->cases = other->cases; } // Copy constructor for push function
-};
-
-class Stack {
-    int topIndex; // Index of top vertex in array, initialized to -1 before any vertices are pushed into stack
-    StackNode* arr = new StackNode[712000]; // Num vertices: 711650 < 712000
-public:
-    int totalCases = 0;
-
-    Stack() { topIndex = -1; } // Constructor, initializes topIndex to -1
-    ~Stack() { delete[] arr; } // Destructor, deletes array from memory
-
-    void push(string state, int cases); // Add vertex to top of stack
-    void pop(); // Remove top vertex from stack
-    StackNode* top(); // Return top vertex in stack
-    int size() { return topIndex + 2; } // Return size of stack
-    bool isEmpty() { return topIndex < 0; } // Return whether stack is empty or not
-};
-
-void Stack::push(string state, int cases) {
-    if(this->size() < 712000) {
-        this->topIndex++;
-        this->arr[topIndex] = new StackNode(state, cases);
-        this->totalCases += cases;
-    }
-    // Will fail to push if stack is full (this shouldn't happen, but is implemented just in case)
-}
-
-void Stack::pop() {
-    if(this->size() > 0) {
-        this->arr[topIndex] = new StackNode("Empty", -1);
-        this->topIndex--;
-    }
-    // Will only pop if stack is not empty
-}
-
-StackNode* Stack::top() {
-    if(topIndex > -1) {
-        return &this->arr[topIndex];
-    }
-    else {
-        return new StackNode("Failed", -1);
-    }
-    // Will return -1 if stack is empty (this shouldn't happen, but is implemented just in case)
-}
-sf::Color heatIntensity(int stateCases, int totalCases){//function to output a sfml color to be displayed
-    double weight = (double) stateCases / totalCases; //find a weight
-    unsigned char red,blue,green;
-    if(weight > 0.05){//make the color a darker red if the weight is more than 5%
-        blue = 0;
-        green = 0;
-        red = ((1-weight)*.3) * 255;//just some formula to create a color, can be adjusted
-    }
-    else{//make the color a lighter red if the weight is less than 5%
-        red = 255;
-        blue = ((1-weight * 20)) * 255;
-        green = ((1-weight * 20)) * 255;//just some formula to create a color, can be adjusted
-    }
-    return {red,blue,green};
-}
-int main(){
-    const int width = 1762;//constant map width to help with sfml adjustments
-    const int height = 1271;//as above
-    const int STATES = 50;
+int main(int argc, char* argv[]){
+    auto programStart = chrono::high_resolution_clock::now();//start of the startup timer
+    if(argc > 1)//any arguments run the headless command line mode instead of the window
+        return runCli(argc, argv);
+    ResourceCache cache;//every image and the font, decoded once in the background while the window opens
+    cache.preload();
+    const int width = MAP_WIDTH;//constant map width to help with sfml adjustments
+    const int height = MAP_HEIGHT;//as above
     sf::Sprite heatMapSprite;//sprite to hold the current desired map output
     sf::Sprite mapSprite;//sprite to hold the original blank map
-    sf::Texture mapTexture;//texture to load images into
-    mapTexture.loadFromFile("images/BWMap.png");
-    mapSprite.setTexture(mapTexture);//load the texture into the sprite
-    heatMapSprite.setTexture(mapTexture);
-    vector<string> stateStrings = {"Alabama","Alaska","Arizona","Arkansas","California","Colorado","Connecticut"
-    ,"Delaware","Florida","Georgia","Hawaii","Idaho","Illinois","Indiana","Iowa","Kansas","Kentucky","Louisiana"
-    ,"Maine","Maryland","Massachusetts","Michigan","Minnesota","Mississippi","Missouri","Montana","Nebraska"
-    ,"Nevada","New Hampshire","New Jersey","New Mexico","New York","North Carolina","North Dakota","Ohio"
-    ,"Oklahoma","Oregon","Pennsylvania","Rhode Island","South Carolina","South Dakota","Tennessee","Texas"
-    ,"Utah","Vermont","Virginia","Washington","West Virginia","Wisconsin","Wyoming"};
-    vector<pair<int,int>> stateLocations = {{1156,625},{85,752},{299,550},{955,585},{69,323}
-            ,{493,424},{1543,289},{1499,389},{1199,756},{1235,614},{473,905}
-            ,{288,108},{1029,362},{1143,382},{878,332},{710,466},{1114,468},{982,717}
-            ,{1563,72},{1398,396},{1539,247},{1040,184},{850,144},{1065,635}
-            ,{908,448},{357,111},{657,362},{181,343},{1551,166},{1502,331}
-            ,{464,561},{1360,197},{1287,503},{664,141},{1223,351},{675,567}
-            ,{87,174},{1343,313},{1590,287},{1315,592},{662,255},{1094,547}
-            ,{537,584},{339,371},{1505,171},{1295,426},{134,76},{1313,394}
-            ,{979,217},{455,279}};//holds found locations so that individual state sprites line up with the map
+    const sf::Font& font = cache.getFont();//font for button labels and timers
+    HeatmapRenderer renderer(cache);//all 50 states drawn from the atlas in one call
+    vector<string> stateStrings(begin(STATE_NAMES), end(STATE_NAMES));//state names, in the same order as the state images
+    vector<Button> buttons = {{"Stack",707,995,202,93},{"Map",920,995,202,93},{"Parallel",1133,995,202,93},{"Hash",1346,995,202,93},{"B-Tree",494,995,202,93}};//found button regions, indexed by Backend
+    int activeBackend = -1;//backend shown on the current heatmap, -1 for the blank map
+    long long startupMicros = 0;//time from launch until the cached textures were ready
+    long long redrawMicros = 0;//time to redraw the heatmap after the last click
+    AggregateResult lastResult;//totals and timers of the heatmap being shown
+    BaseMap lastBase = BLANK_MAP;//map image drawn under the states
+    bool reveal = false;//opt-in animation filling the states in one by one, toggled with R
+    int revealedStates = STATE_COUNT;//states drawn so far while revealing
+    sf::Clock revealClock;//time since the reveal started
+    const int REVEAL_MILLIS_PER_STATE = 20;//one second to reveal every state
+    Button dailyButton = {"Daily",1559,995,202,93};//switches to the per-day view with the date scrubber
+    TimeSeries series;//per-day totals of every state, built the first time Daily is clicked
+    bool dailyMode = false;//whether the map shows one day of the series instead of a backend's totals
+    int dayIndex = 0;//day of the series being shown
+    bool playing = false;//whether playback is stepping through the days, toggled with space
+    bool scrubbing = false;//whether the scrubber is being dragged
+    sf::Clock playClock;//time since playback last advanced a day
+    const int PLAY_MILLIS_PER_DAY = 33;//about 30 days a second
+    IncrementalAggregator liveMap(MAP), liveHash(HASH);//Map and Hash totals persist between clicks, only appended rows are read
+    FileWatcher watcher("cases.csv");//new rows refresh the Map or Hash heatmap without a click
+    bool refreshRequested = false;//F5 refreshes on demand
+    CountyMap counties;//county outlines, loaded the first time county mode is turned on
+    CountyCounter countyCases;//cases of every county by FIPS code
+    bool countyMode = false;//whether the map shows counties instead of states, toggled with C
+    int hoveredCounty = -1;//county under the mouse in county mode, -1 if there is none
+    bool countySample = false;//whether counties holds the synthetic tiles of COUNTY_SAMPLE_FILE, labelled on screen as long as they are shown
+    const int SCRUB_LEFT = 300, SCRUB_RIGHT = 1660, SCRUB_TOP = 20, SCRUB_HEIGHT = 24;//scrubber bar above the map
+    ColorScale stateScale = LINEAR_SCALE;//scale of the state heatmaps, cycled with L
+    ColorScale countyScale = LOG_SCALE;//counties span a wider range than states, so they start on a log scale
+    Palette palette = HEAT_PALETTE;//cycled with P
+    bool gpuShading = false;//color per pixel with a shader instead of tinted quads and triangles, toggled with G
+    bool overlay = false;//stage timings of the last run of each backend, toggled with O
+    vector<AggregateResult> lastRuns(BACKENDS);//last result of each backend, for the overlay
+    vector<size_t> lastRunPeaks(BACKENDS, 0);//peak resident size after each backend's last run
+    vector<StageTime> compositeTimes, presentTimes;//latest composite and present, cleared before each one so they do not grow
+    const char* TRACE_FILE = "trace.json";//written when tracing is turned off with T
+    BackgroundLoad loader;//reads cases.csv off the GUI thread so frames keep drawing during a load
+    function<void()> onLoaded;//applies the finished load's results, run on this thread once the loader is done
+    string loadLabel;//what is being loaded, shown with the progress bar
+    AggregateResult loadedResult;//written by the loader, read only after it finishes
+    TimeSeries loadedSeries;//as above, moved into series when the load was not cancelled
 
     sf::RenderTexture renderTexture;//2d unseen render for adding to the heatmap sprite
     renderTexture.create(width,height);//designate the rendertexture with a width and height
+    auto renderHeatmap = [&](int visibleStates) {//composite the base map, the states and the timers into the render texture
+        compositeTimes.clear();
+        TraceScope composite("composite", &compositeTimes);
+        renderTexture.clear();//clear the current drawing render so it can be re-drawn
+        if(countyMode) {//every county in one draw over the blank map, the hovered county is labelled in the window
+            renderTexture.draw(sf::Sprite(cache.baseMap(BLANK_MAP)));
+            counties.draw(renderTexture);
+            renderTexture.display();
+            heatMapSprite.setTexture(renderTexture.getTexture());
+            return;
+        }
+        renderer.draw(renderTexture, lastBase, visibleStates);
+        if(dailyMode) {//the date and totals are drawn with the scrubber, there are no timers to show
+            renderTexture.display();
+            heatMapSprite.setTexture(renderTexture.getTexture());
+            return;
+        }
+        for(size_t rank = 0; rank < lastResult.hotspots.size(); rank++) {//number the top states, most cases first
+            int state = lastResult.hotspots[rank];
+            if(state >= visibleStates)//not revealed yet
+                continue;
+            const sf::IntRect& rect = cache.stateRect(state);
+            sf::Vector2f center(STATE_LOCATIONS[state].x + rect.width / 2.f, STATE_LOCATIONS[state].y + rect.height / 2.f);
+            sf::CircleShape badge(16);
+            badge.setOrigin(16,16);
+            badge.setPosition(center);
+            badge.setFillColor({255,255,255,220});
+            badge.setOutlineColor({0,0,0});
+            badge.setOutlineThickness(2);
+            renderTexture.draw(badge);
+            sf::Text number(to_string(rank + 1), font, 20);
+            number.setFillColor({0,0,0});
+            sf::FloatRect bounds = number.getLocalBounds();
+            number.setPosition(center.x - bounds.width / 2 - bounds.left, center.y - bounds.height / 2 - bounds.top);
+            renderTexture.draw(number);
+        }
+        if(activeBackend >= PARALLEL) {//newer backends are not part of the map images, so label the timer here
+            sf::Text label("Retrieval Time(us):", font, 26);
+            label.setFillColor({0,0,0});
+            label.setPosition(552,1122);
+            renderTexture.draw(label);
+        }
+        sf::Text timer(to_string(lastResult.retrievalMicros),font);//text for displaying the timer
+        timer.setFillColor({0,0,0});
+        timer.setPosition(818,1113);//found position
+        renderTexture.draw(timer);//draw the new timer to the render
+        sf::Text loadTimer("Load Time(us): " + to_string(lastResult.loadMicros),font);//text for displaying the load timer
+        loadTimer.setFillColor({0,0,0});
+        loadTimer.setPosition(552,1150);//below the retrieval timer
+        renderTexture.draw(loadTimer);
+        sf::Text statsText(lastResult.stats,font,24);
+        statsText.setFillColor({0,0,0});
+        statsText.setPosition(552,1190);
+        renderTexture.draw(statsText);
+        renderTexture.display();//finish drawing so the texture is right side up
+        heatMapSprite.setTexture(renderTexture.getTexture());
+    };
+    auto showDay = [&](int index) {//recolor the map for one day of the series, the file is not read again
+        dayIndex = max(0, min(series.dayCount() - 1, index));
+        auto redrawStart = chrono::high_resolution_clock::now();
+        renderer.setCases(series.casesOn(dayIndex));
+        renderHeatmap(STATE_COUNT);
+        redrawMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - redrawStart).count();
+    };
+    auto scrubTo = [&](int x) {//show the day under x on the scrubber
+        showDay((x - SCRUB_LEFT) * (series.dayCount() - 1) / (SCRUB_RIGHT - SCRUB_LEFT));
+    };
+    auto recolor = [&]() {//apply a new scale, palette or shading to whatever is shown, nothing is read again
+        renderer.setScale(stateScale, palette);
+        if(countyMode) {
+            counties.setCases(countyCases, countyScale, palette);
+            renderHeatmap(STATE_COUNT);
+        }
+        else if(dailyMode)
+            showDay(dayIndex);
+        else if(activeBackend != -1) {
+            renderer.setCases(lastResult.stateCases.data());
+            renderHeatmap(revealedStates);
+        }
+    };
+    auto showResult = [&](int backend) {//recolor the map with a finished backend load
+        lastResult = move(loadedResult);
+        lastRuns[backend] = lastResult;
+        lastRunPeaks[backend] = peakResidentBytes();
+        if(!lastResult.ok)
+            cout << "Error opening cases.csv, please rerun the program and try again." << endl;
+        lastBase = BLANK_MAP;
+        if(backend == STACK)
+            lastBase = STACK_MAP;//stack version has a timer and red stack button
+        else if(backend == MAP)
+            lastBase = MAP_MAP;
+        activeBackend = backend;
+        dailyMode = false;
+        countyMode = false;
+        playing = false;
+        auto redrawStart = chrono::high_resolution_clock::now();//start redraw timer
+        renderer.setCases(lastResult.stateCases.data());//only the quad colors change between clicks
+        revealedStates = reveal ? 0 : STATE_COUNT;
+        revealClock.restart();
+        renderHeatmap(revealedStates);
+        redrawMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - redrawStart).count();
+    };
+    auto startLoad = [&](const string& label, function<void(LoadProgress&)> job, function<void()> done) {//run job on the loader, done runs here after it
+        if(!loader.start(move(job)))
+            return;//one load at a time, clicks during a load are ignored
+        loadLabel = label;
+        onLoaded = move(done);
+    };
     sf::RenderWindow window(sf::VideoMode(width,height), "Covid-19 Heatmap");//window where the GUI is displayed
+    window.setFramerateLimit(60);//playback and scrubbing redraw at most once a frame
     while(window.isOpen()){//gui loop, ends when the window is closed
+        if(!cache.isReady() && cache.poll()) {//textures finished loading in the background
+            if(cache.failed())
+                cout << "Error loading images or font, please run the program from the project directory." << endl;
+            mapSprite.setTexture(cache.baseMap(BLANK_MAP));//load the texture into the sprite
+            heatMapSprite = mapSprite;
+            startupMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - programStart).count();
+        }
         sf::Event event;
         while(window.pollEvent(event)){
-            if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Left) {
-                if((event.mouseButton.x > 707 && event.mouseButton.x < 909) && (event.mouseButton.y > 995 && event.mouseButton.y < 1088)) {
-                    //on left click within the "Stack" button region:
-                    Stack s;//create stack to store data in
-                    ifstream casesFile("cases.csv");//create an input stream for data to be read from
-
-                    string line;
-                    getline(casesFile, line); // Skip header line
-
-                    if(casesFile.is_open()) {
-                        while(getline(casesFile, line)) {//read needed data and skip unwanted data line by line
-                            istringstream stream(line);
-                            string skip;
-                            getline(stream, skip, ',');
-                            getline(stream, skip, ',');
-
-                            string state;
-                            getline(stream, state, ',');
-
-                            getline(stream, skip, ',');
-
-                            string cases;
-                            getline(stream, cases, ',');
-
-                            getline(stream, skip);
-
-                            s.push(state, stoi(cases));//add current line to the stack
-                        }
-                    }
-                    else
+            if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape && loader.isRunning())
+                loader.cancel();//the partial results are dropped when the loader finishes
+            else if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Left && cache.isReady()
+                    && dailyButton.contains(event.mouseButton.x, event.mouseButton.y)) {
+                if(loader.isRunning())//a finished load would change the view underneath the series
+                    continue;
+                auto showSeries = [&]() {
+                    dailyMode = true;
+                    countyMode = false;
+                    activeBackend = -1;
+                    lastBase = BLANK_MAP;
+                    revealedStates = STATE_COUNT;
+                    showDay(series.dayCount() - 1);//start on the latest day
+                };
+                if(!series.isEmpty()) {//built once, later clicks reuse it
+                    showSeries();
+                    continue;
+                }
+                startLoad("Daily", [&](LoadProgress& progress) {
+                    if(!loadedSeries.load("cases.csv", 0, &progress))
                         cout << "Error opening cases.csv, please rerun the program and try again." << endl;
-                    casesFile.close();
-                    renderTexture.clear();//clear the current drawing render so it can be re-drawn
-                    sf::Texture newMap;//texture to load in the stack version of the map
-                    newMap.loadFromFile("images/BWMapStack.png");//stack version has a timer and red stack button
-                    sf::Sprite newMapSprite;
-                    newMapSprite.setTexture(newMap);
-                    renderTexture.draw(newMapSprite);//draw the new map to the render
-                    int totalCases = s.totalCases;//get total cases for usage later
-                    vector<int> stateCases(50,0);
-                    int stackSize = s.size();
-                    auto start = chrono::high_resolution_clock::now();//start microsecond timer
-                    /* Find the total number of cases in each state by popping off each data entry and adding it
-                     * to the correct state total.
-                     */
-                    for(int i = 0; i < stackSize -1; i++) {
-                        for(int j = 0; j < stateStrings.size(); j++){
-                            if(stateStrings[j] == s.top()->state) {
-                                stateCases[j] += s.top()->cases;
-                                break;
-                            }
-                        }
-                        s.pop();
-                    }
-                    auto stop = chrono::high_resolution_clock::now();//end microsecond timer
-                    for (int i = 0; i < STATES; i++) {//loop to find and apply the new weighted color to each state's sprite
-                        string stateString = "images/state" + to_string(i) + ".png";
-                        sf::Texture tempTexture;
-                        tempTexture.loadFromFile(stateString);//load the state texture from the image files
-                        sf::Sprite tempSprite;
-                        tempSprite.setTexture(tempTexture);//set the state sprite
-                        tempSprite.setColor(heatIntensity(stateCases[i], totalCases));//set the state sprite's color
-                        tempSprite.setPosition(stateLocations[i].first, stateLocations[i].second);
-                        renderTexture.draw(tempSprite);//render texture flips pixels
-                        heatMapSprite.setTexture(renderTexture.getTexture());
-                        heatMapSprite.setTextureRect(sf::IntRect(0, height, width, -height));//flip texture back
-                        window.draw(heatMapSprite);//draw the updated map sprite
-                        window.display();//display current sprite
+                }, [&, showSeries]() {
+                    series = move(loadedSeries);
+                    loadedSeries = TimeSeries();
+                    if(!series.isEmpty())
+                        showSeries();
+                });
+            }
+            else if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Left && dailyMode
+                    && event.mouseButton.y >= SCRUB_TOP && event.mouseButton.y < SCRUB_TOP + SCRUB_HEIGHT
+                    && event.mouseButton.x >= SCRUB_LEFT && event.mouseButton.x <= SCRUB_RIGHT) {
+                scrubbing = true;
+                playing = false;
+                scrubTo(event.mouseButton.x);
+            }
+            else if(event.type == sf::Event::MouseMoved && scrubbing)
+                scrubTo(event.mouseMove.x);
+            else if(event.type == sf::Event::MouseButtonReleased)
+                scrubbing = false;
+            else if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Left && cache.isReady()) {
+                int backend = -1;
+                for(int i = 0; i < BACKENDS; i++) {
+                    if(buttons[i].contains(event.mouseButton.x, event.mouseButton.y))
+                        backend = i;
+                }
+                if(backend == -1)
+                    continue;
+
+                startLoad(buttons[backend].label, [&, backend](LoadProgress& progress) {
+                    if(backend == MAP || backend == HASH) {
+                        IncrementalAggregator& live = backend == MAP ? liveMap : liveHash;
+                        live.refresh("cases.csv", &progress);//the whole file on the first click, afterwards only rows appended since
+                        loadedResult = live.result(stateStrings);
                     }
-
-                    auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);//compute the difference in time
-                    sf::Font font;//font for creating text
-                    font.loadFromFile("Cave-Story.ttf");
-                    sf::Text timer(to_string(duration.count()),font);//text for displaying the timer
-                    timer.setFillColor({0,0,0});
-                    timer.setPosition(818,1113);//found position
-                    renderTexture.draw(timer);//draw the new timer to the render
-                    heatMapSprite.setTexture(renderTexture.getTexture());
-                    heatMapSprite.setTextureRect(sf::IntRect(0, height, width, -height));
+                    else//read the file with the chosen backend, from its snapshot after the first click
+                        loadedResult = aggregate(static_cast<Backend>(backend), "cases.csv", stateStrings, true, &progress);
+                }, [&, backend]() { showResult(backend); });
+            }
+            else if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Right && !loader.isRunning()) {
+                heatMapSprite = mapSprite;//reload a blank map into the heatmap sprite on right click
+                activeBackend = -1;
+                revealedStates = STATE_COUNT;
+                dailyMode = false;
+                countyMode = false;
+                playing = false;
+            }
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R)
+                reveal = !reveal;
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::L && cache.isReady()) {
+                ColorScale& scale = countyMode ? countyScale : stateScale;
+                scale = static_cast<ColorScale>((scale + 1) % COLOR_SCALES);
+                recolor();
+            }
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P && cache.isReady()) {
+                palette = static_cast<Palette>((palette + 1) % PALETTES);
+                recolor();
+            }
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::G && cache.isReady()) {
+                if(!RegionShader::isAvailable()) {
+                    cout << "Shaders are not supported by this graphics driver, staying on vertex colors." << endl;
+                    continue;
                 }
-                else if((event.mouseButton.x > 920 && event.mouseButton.x < 1122) && (event.mouseButton.y > 995 && event.mouseButton.y < 1088)) {
-                    //On left click of the "Map" button
-                    Map m;//create map object
-
-                    ifstream casesFile("cases.csv");//as in the stack section
-
-                    string line;
-                    getline(casesFile, line); // Skip header line
-
-                    if(casesFile.is_open()) {
-                        while(getline(casesFile, line)) {
-                            istringstream stream(line);
-                            string skip;
-                            getline(stream, skip, ',');
-                            getline(stream, skip, ',');
-
-                            string state;
-                            getline(stream, state, ',');
-
-                            getline(stream, skip, ',');
-
-                            string cases;
-                            getline(stream, cases, ',');
-
-                            getline(stream, skip);
-
-                            m.insert(state, stoi(cases));
+                gpuShading = renderer.setShaderEnabled(!gpuShading);//the ID textures are built the first time
+                if(!loader.isRunning() && !counties.isEmpty())//a Counties load may be filling counties, its done callback applies gpuShading
+                    counties.setShaderEnabled(gpuShading, width, height);
+                recolor();
+            }
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::O)
+                overlay = !overlay;
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::T) {
+                if(!tracingEnabled()) {
+                    clearTrace();
+                    setTracing(true);
+                    continue;
+                }
+                setTracing(false);
+                if(writeChromeTrace(TRACE_FILE))
+                    cout << "Wrote " << traceEventCount() << " trace events to " << TRACE_FILE << ", open it in chrome://tracing or Perfetto." << endl;
+                else
+                    cout << "Error writing " << TRACE_FILE << endl;
+            }
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F5)
+                refreshRequested = true;
+            else if(event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::C && cache.isReady()) {
+                if(countyMode) {
+                    countyMode = false;
+                    heatMapSprite = mapSprite;
+                    continue;
+                }
+                bool needGeometry = counties.isEmpty();//geometry is tessellated once, on the loader like the cases
+                startLoad("Counties", [&, needGeometry](LoadProgress& progress) {
+                    if(needGeometry && !counties.load(COUNTY_GEOMETRY_FILE, width, height)) {
+                        if(!counties.load(COUNTY_SAMPLE_FILE, width, height)) {
+                            cout << "Error loading " << COUNTY_GEOMETRY_FILE << ", build it with MakeCounties.py from a county GeoJSON file." << endl;
+                            return;
                         }
+                        countySample = true;//read on this thread only once the load is done
+                        cout << COUNTY_GEOMETRY_FILE << " is missing, showing the synthetic tiles of " << COUNTY_SAMPLE_FILE
+                             << ". Build the real outlines with MakeCounties.py." << endl;
                     }
-                    else
+                    if(!countyCases.load("cases.csv", &progress)) {
                         cout << "Error opening cases.csv, please rerun the program and try again." << endl;
-                    int totalCases = m.totalCases;
-                    vector<int> stateCases(50);
-                    auto start = chrono::high_resolution_clock::now();
-                    /* Get number of cases in each state by using the map's getCases function
-                     * since the map uses a balanced tree data can efficiently be grabbed
-                     */
-                    for(int i = 0; i < stateCases.size(); i++){
-                        stateCases[i] = m.getCases(stateStrings[i]);
+                        countyCases.clear();
                     }
-                    auto stop = chrono::high_resolution_clock::now();
-                    renderTexture.clear();
-                    sf::Texture newMap;
-                    newMap.loadFromFile("images/BWMapMap.png");
-                    sf::Sprite newMapSprite;
-                    newMapSprite.setTexture(newMap);
-                    renderTexture.draw(newMapSprite);
-                    for (int i = 0; i < STATES; i++) {
-                        string imgString = "images/state" + to_string(i) + ".png";
-                        sf::Texture tempTexture;
-                        tempTexture.loadFromFile(imgString);
-                        sf::Sprite tempSprite;
-                        tempSprite.setTexture(tempTexture);
-                        tempSprite.setColor(heatIntensity(stateCases[i], totalCases));
-                        tempSprite.setPosition(stateLocations[i].first, stateLocations[i].second);
-                        renderTexture.draw(tempSprite);
-                        heatMapSprite.setTexture(renderTexture.getTexture());
-                        heatMapSprite.setTextureRect(sf::IntRect(0, height, width, -height));
-                        window.draw(heatMapSprite);
-                        window.display();
-                    }
-
-                    auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
-                    sf::Font font;
-                    font.loadFromFile("Cave-Story.ttf");
-                    sf::Text timer(to_string(duration.count()),font);
-                    timer.setFillColor({0,0,0});
-                    timer.setPosition(818,1113);
-                    renderTexture.draw(timer);
-                    heatMapSprite.setTexture(renderTexture.getTexture());
-                    heatMapSprite.setTextureRect(sf::IntRect(0, height, width, -height));
-                }
+                }, [&, needGeometry]() {
+                    if(needGeometry && !counties.isEmpty())
+                        counties.upload();//the vertex buffer belongs to this thread's GL context
+                    if(!counties.isEmpty())//G may have been pressed during the load
+                        counties.setShaderEnabled(gpuShading, width, height);
+                    if(counties.isEmpty() || countyCases.rows == 0)
+                        return;
+                    countyMode = true;
+                    dailyMode = false;
+                    playing = false;
+                    activeBackend = -1;
+                    hoveredCounty = -1;
+                    auto redrawStart = chrono::high_resolution_clock::now();
+                    counties.setCases(countyCases, countyScale, palette);
+                    renderHeatmap(STATE_COUNT);
+                    redrawMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - redrawStart).count();
+                });
             }
-            else if(event.type == sf::Event::MouseButtonPressed && event.key.code == sf::Mouse::Right) {
-                heatMapSprite = mapSprite;//reload a blank map into the heatmap sprite on right click
+            else if(event.type == sf::Event::MouseMoved && countyMode)
+                hoveredCounty = counties.regionAt(event.mouseMove.x, event.mouseMove.y);
+            else if(event.type == sf::Event::KeyPressed && dailyMode) {
+                if(event.key.code == sf::Keyboard::Space) {
+                    playing = !playing;
+                    if(playing && dayIndex == series.dayCount() - 1)//replay from the first day
+                        showDay(0);
+                    playClock.restart();
+                }
+                else if(event.key.code == sf::Keyboard::Left)
+                    showDay(dayIndex - 1);
+                else if(event.key.code == sf::Keyboard::Right)
+                    showDay(dayIndex + 1);
             }
             else if(event.type == sf::Event::Closed)//end loop and program if the window is closed
                 window.close();
         }
-        window.clear();//clear the window so it can be redrawn
-        window.draw(heatMapSprite);//draw whatever is in the heatMapSprite to the window
+        if(activeBackend != -1 && revealedStates < STATE_COUNT) {//reveal a few more states each frame, input is still handled between them
+            int due = min(STATE_COUNT, revealClock.getElapsedTime().asMilliseconds() / REVEAL_MILLIS_PER_STATE + 1);
+            if(due > revealedStates) {
+                revealedStates = due;
+                renderHeatmap(revealedStates);
+            }
+        }
+        if(loader.poll()) {//the load finished this frame, apply it here where the textures live
+            if(loader.wasCancelled()) {//partial totals are never shown
+                loadedResult = AggregateResult();
+                loadedSeries = TimeSeries();
+            }
+            else if(onLoaded)
+                onLoaded();
+            onLoaded = nullptr;
+        }
+        bool fileChanged = watcher.changed();//polled every frame so pending change events are drained
+        if((fileChanged || refreshRequested) && (activeBackend == MAP || activeBackend == HASH) && !loader.isRunning()) {//ingest appended rows and redraw
+            int backend = activeBackend;
+            bool forced = refreshRequested;
+            startLoad("Refresh", [&, backend](LoadProgress& progress) {
+                IncrementalAggregator& live = backend == MAP ? liveMap : liveHash;
+                live.refresh("cases.csv", &progress);
+                loadedResult = live.result(stateStrings);
+            }, [&, backend, forced]() {
+                if(activeBackend != backend || dailyMode || countyMode) {//the view changed during the refresh, the totals stay in the aggregator for the next click
+                    loadedResult = AggregateResult();
+                    return;
+                }
+                if(loadedResult.rows == lastResult.rows && loadedResult.totalCases == lastResult.totalCases && !forced)//nothing complete was appended or rewritten
+                    return;
+                lastResult = move(loadedResult);
+                lastRuns[backend] = lastResult;
+                lastRunPeaks[backend] = peakResidentBytes();
+                auto redrawStart = chrono::high_resolution_clock::now();
+                renderer.setCases(lastResult.stateCases.data());
+                renderHeatmap(STATE_COUNT);
+                redrawMicros = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - redrawStart).count();
+            });
+        }
+        refreshRequested = false;
+        if(playing && playClock.getElapsedTime().asMilliseconds() >= PLAY_MILLIS_PER_DAY) {//advance playback without blocking input
+            int steps = playClock.getElapsedTime().asMilliseconds() / PLAY_MILLIS_PER_DAY;
+            playClock.restart();
+            showDay(dayIndex + steps);
+            if(dayIndex == series.dayCount() - 1)
+                playing = false;
+        }
+        window.clear(sf::Color::White);//clear the window so it can be redrawn
+        if(cache.isReady()) {//the window stays blank until the textures have loaded
+            window.draw(heatMapSprite);//draw whatever is in the heatMapSprite to the window
+            for(int i = PARALLEL; i < BACKENDS; i++)//buttons that are not part of the map images
+                drawButton(window, buttons[i], font, i == activeBackend);
+            drawButton(window, dailyButton, font, dailyMode);
+            if(countyMode) {
+                string label = "Counties: " + to_string(counties.size()) + "  Load Time(us): " + to_string(countyCases.loadMicros);
+                if(hoveredCounty >= 0) {
+                    int fips = counties.fipsOf(hoveredCounty);
+                    string code = to_string(fips);
+                    label = (countySample ? "Tile of county " : "County ") + string(5 - code.size(), '0') + code + ": "
+                            + to_string(countyCases.getCases(fips)) + " cases";
+                }
+                sf::Text countyText(label, font);
+                countyText.setFillColor({0,0,0});
+                countyText.setPosition(552,1113);
+                window.draw(countyText);
+                if(countySample) {//the tiles only stand in for the outlines, so the map never looks like real county shapes
+                    sf::Text sampleText("SYNTHETIC TILES, NOT COUNTY OUTLINES: " + string(COUNTY_GEOMETRY_FILE) + " is missing, build it with MakeCounties.py", font, 24);
+                    sampleText.setFillColor({200,0,0});
+                    sampleText.setPosition(552,1160);
+                    window.draw(sampleText);
+                }
+            }
+            if(dailyMode) {//scrubber with a handle on the day being shown
+                sf::RectangleShape bar(sf::Vector2f(SCRUB_RIGHT - SCRUB_LEFT, SCRUB_HEIGHT / 4));
+                bar.setPosition(SCRUB_LEFT, SCRUB_TOP + SCRUB_HEIGHT * 3 / 8);
+                bar.setFillColor(sf::Color(160,160,160));
+                window.draw(bar);
+                sf::RectangleShape handle(sf::Vector2f(8, SCRUB_HEIGHT));
+                float x = SCRUB_LEFT + (series.dayCount() > 1 ? (float) dayIndex * (SCRUB_RIGHT - SCRUB_LEFT) / (series.dayCount() - 1) : 0);
+                handle.setPosition(x - 4, SCRUB_TOP);
+                handle.setFillColor(sf::Color(236,100,100));
+                window.draw(handle);
+                sf::Text date(series.dateOf(dayIndex), font, 26);
+                date.setFillColor({0,0,0});
+                date.setPosition(100, SCRUB_TOP - 4);
+                window.draw(date);
+                sf::Text dayTotals("Cases: " + to_string(series.totalOn(dayIndex)) + "  New: " + to_string(series.newTotal(dayIndex, dayIndex)), font);
+                dayTotals.setFillColor({0,0,0});
+                dayTotals.setPosition(552,1113);
+                window.draw(dayTotals);
+                sf::Text help("Space: play/pause  Left/Right: step a day  Load Time(us): " + to_string(series.loadMicros), font, 24);
+                help.setFillColor({0,0,0});
+                help.setPosition(552,1160);
+                window.draw(help);
+            }
+            if(loader.isRunning()) {//progress of the background load, input and drawing carry on while it runs
+                const LoadProgress& progress = loader.getProgress();
+                size_t total = progress.bytesTotal, done = progress.bytesDone;
+                float fraction = total > 0 ? min(1.f, (float) done / total) : 0;
+                double seconds = max(loader.elapsedSeconds(), 0.001);
+                sf::RectangleShape track(sf::Vector2f(SCRUB_RIGHT - SCRUB_LEFT, SCRUB_HEIGHT));
+                track.setPosition(SCRUB_LEFT, SCRUB_TOP + SCRUB_HEIGHT + 8);
+                track.setFillColor(sf::Color(220,220,220));
+                window.draw(track);
+                sf::RectangleShape fill(sf::Vector2f((SCRUB_RIGHT - SCRUB_LEFT) * fraction, SCRUB_HEIGHT));
+                fill.setPosition(SCRUB_LEFT, SCRUB_TOP + SCRUB_HEIGHT + 8);
+                fill.setFillColor(sf::Color(236,100,100));
+                window.draw(fill);
+                string status = "Loading " + loadLabel + ": " + to_string((int) (fraction * 100)) + "%  "
+                              + to_string((long long) (progress.rows / seconds)) + " rows/s  "
+                              + (loader.wasCancelled() ? "cancelling..." : "Esc: cancel");
+                sf::Text loading(status, font, 22);
+                loading.setFillColor({0,0,0});
+                loading.setPosition(SCRUB_LEFT + 8, SCRUB_TOP + SCRUB_HEIGHT + 8);
+                window.draw(loading);
+            }
+            if(overlay) {//where the time of each backend's last run went, and what the latest frame cost
+                string text = string("Last run of each backend (O: hide)  Trace (T): ") + (tracingEnabled() ? "recording " + to_string(traceEventCount()) + " events" : "off") + "\n";
+                for(int b = 0; b < BACKENDS; b++) {
+                    const AggregateResult& run = lastRuns[b];
+                    if(run.stages.empty())
+                        continue;
+                    long long micros = run.loadMicros + run.retrievalMicros;
+                    text += buttons[b].label + ": " + to_string(micros > 0 ? (long long) (run.rows * 1e6 / micros) : 0) + " rows/s ";
+                    for(const StageTime& stage : run.stages)
+                        text += " " + string(stage.name) + " " + to_string(stage.micros) + " us";
+                    text += "  allocs " + to_string(run.allocations) + "  peak " + to_string(lastRunPeaks[b] / (1024 * 1024)) + " MB\n";
+                }
+                text += "Composite: " + to_string(compositeTimes.empty() ? 0 : compositeTimes.back().micros) + " us  Present: "
+                      + to_string(presentTimes.empty() ? 0 : presentTimes.back().micros) + " us";
+                sf::Text overlayText(text, font, 18);
+                overlayText.setFillColor({0,0,0});
+                overlayText.setPosition(20,90);
+                sf::FloatRect bounds = overlayText.getGlobalBounds();
+                sf::RectangleShape panel(sf::Vector2f(bounds.width + 16, bounds.height + 16));
+                panel.setPosition(bounds.left - 8, bounds.top - 8);
+                panel.setFillColor({255,255,255,220});
+                window.draw(panel);
+                window.draw(overlayText);
+            }
+            sf::Text colorText(string("Scale (L): ") + COLOR_SCALE_NAMES[countyMode ? countyScale : stateScale] + "  Palette (P): "
+                               + PALETTE_NAMES[palette] + "  Shader (G): " + (gpuShading ? "on" : "off"), font, 20);
+            colorText.setFillColor({0,0,0});
+            colorText.setPosition(20,1230);
+            window.draw(colorText);
+            sf::Text timing("Startup: " + to_string(startupMicros / 1000) + " ms  Redraw: " + to_string(redrawMicros / 1000) + " ms  Reveal (R): " + (reveal ? "on" : "off") + "  Counties (C)", font, 24);
+            timing.setFillColor({0,0,0});
+            timing.setPosition(552,1225);
+            window.draw(timing);
+        }
+        presentTimes.clear();
+        TraceScope present("present", &presentTimes);
         window.display();//display the current view of the window
     }
     return 0;
-}
\ No newline at end of file
+}